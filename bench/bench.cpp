@@ -0,0 +1,393 @@
+#include "../src/tools.h"
+
+// Microbenchmarks for the game library. Every case runs timed batches until it has used its
+// time budget, and the suite prints the median and fastest batch per operation as JSON, so
+// two runs can be compared by a script.
+
+struct Sample {
+    uint64_t ops;
+    double ns;
+};
+
+struct Result {
+    std::string name;
+    size_t batches;
+    uint64_t opsPerBatch;
+    double medianNs;
+    double minNs;
+};
+
+template <typename F>
+double elapsedNs(F&& f) {
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+}
+
+class BenchSuite {
+private:
+    static constexpr size_t MIN_BATCHES = 3;
+    static constexpr size_t MAX_BATCHES = 10000;
+
+    double budgetNs;
+    std::string filter;
+    std::vector<Result> results;
+
+public:
+    // Folded into the output so the compiler can't drop the work being timed.
+    uint64_t checksum = 0;
+
+    BenchSuite(double budgetSeconds, std::string nameFilter)
+        : budgetNs(budgetSeconds * 1e9), filter(std::move(nameFilter)) {}
+
+    bool wants(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // `batch` does some work and returns how many operations it timed and how long they took,
+    // so cases can leave their setup out of the measurement.
+    template <typename Batch>
+    void run(const std::string& name, Batch&& batch) {
+        if (!wants(name)) return;
+        std::vector<double> perOp;
+        uint64_t ops = 0;
+        double spent = 0;
+        while (perOp.size() < MAX_BATCHES && (perOp.size() < MIN_BATCHES || spent < budgetNs)) {
+            Sample sample = batch();
+            ops = sample.ops;
+            spent += sample.ns;
+            perOp.push_back(sample.ns / double(std::max<uint64_t>(sample.ops, 1)));
+        }
+        std::sort(perOp.begin(), perOp.end());
+        results.push_back(Result{name, perOp.size(), ops, perOp[perOp.size() / 2], perOp.front()});
+        std::cerr << "  " << name << ": " << results.back().medianNs << " ns/op" << std::endl;
+    }
+
+    void writeJson(std::ostream& out) const {
+        char line[256];
+        out << "{\n  \"context\": {\n";
+        out << "    \"threads\": " << std::thread::hardware_concurrency() << ",\n";
+        out << "    \"log_level\": " << ANKR_LOG << ",\n";
+        out << "    \"checksum\": " << checksum << "\n  },\n";
+        out << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"batches\": %zu, \"ops_per_batch\": %llu, "
+                          "\"median_ns\": %.3f, \"min_ns\": %.3f}%s\n",
+                          r.name.c_str(), r.batches, (unsigned long long)r.opsPerBatch, r.medianNs, r.minNs,
+                          i + 1 < results.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+    }
+};
+
+// Takes whatever Map::display writes and throws it away.
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    int overflow(int c) override { return c; }
+};
+
+class DiscardSink : public TextSink {
+public:
+    uint64_t bytes = 0;
+    void write(const char*, size_t size) override { bytes += size; }
+};
+
+std::vector<std::pair<int, int>> randomCoords(int width, int height, size_t count) {
+    std::vector<std::pair<int, int>> coords(count);
+    Rng rng(0x9E3779B97F4A7C15ULL);
+    for (auto& c : coords) {
+        c.first = rng.range(1, width - 2);
+        c.second = rng.range(1, height - 2);
+    }
+    return coords;
+}
+
+void benchMap(BenchSuite& suite) {
+    const int size = 1024;
+    const size_t lookups = 1 << 20;
+    std::vector<std::pair<int, int>> coords = randomCoords(size, size, 1 << 16);
+    Map map(size, size);
+    for (size_t i = 0; i < coords.size(); i += 3) map.setTile(coords[i].first, coords[i].second, TileType::WALL);
+
+    suite.run("map/getTile", [&] {
+        uint64_t sum = 0;
+        double ns = elapsedNs([&] {
+            for (size_t i = 0; i < lookups; ++i) {
+                const auto& c = coords[i & (coords.size() - 1)];
+                sum += uint64_t(map.getTile(c.first, c.second));
+            }
+        });
+        suite.checksum += sum;
+        return Sample{lookups, ns};
+    });
+
+    suite.run("map/setTile", [&] {
+        double ns = elapsedNs([&] {
+            for (size_t i = 0; i < lookups; ++i) {
+                const auto& c = coords[i & (coords.size() - 1)];
+                map.setTile(c.first, c.second, TileType(i & 3));
+            }
+        });
+        suite.checksum += map.countOf(TileType::ENEMY);
+        return Sample{lookups, ns};
+    });
+
+    NullBuffer nothing;
+    std::ostream out(&nothing);
+    for (int viewSize : { 40, 200 }) {
+        Map view(viewSize, viewSize / 2);
+        for (int x = 6; x < viewSize - 6; x += 5) view.fillRect(x, 4, x + 1, viewSize / 2 - 4, TileType::WALL);
+        suite.run("map/display_" + std::to_string(viewSize) + "x" + std::to_string(viewSize / 2), [&] {
+            const uint64_t frames = 64;
+            double ns = elapsedNs([&] {
+                for (uint64_t i = 0; i < frames; ++i) view.display(out);
+            });
+            return Sample{frames, ns};
+        });
+    }
+}
+
+void benchRender(BenchSuite& suite) {
+    Map map(38, 18);
+    for (int x = 6; x < 32; x += 5) map.fillRect(x, 4, x + 1, 14, TileType::WALL);
+    DiscardSink sink;
+    TerminalRenderer renderer(80, 23);
+    renderer.setSink(&sink);
+    int heroX = 1, heroY = 1, dx = 1;
+    suite.run("render/frame", [&] {
+        const uint64_t frames = 1000;
+        double ns = elapsedNs([&] {
+            char status[96];
+            for (uint64_t i = 0; i < frames; ++i) {
+                map.setTile(heroX, heroY, TileType::EMPTY);
+                if (map.getTile(heroX + dx, heroY) != TileType::EMPTY) {
+                    dx = -dx;
+                    heroY = heroY % (map.getHeight() - 2) + 1;
+                } else {
+                    heroX += dx;
+                }
+                map.setTile(heroX, heroY, TileType::HERO);
+                std::snprintf(status, sizeof(status), "You are at (%d, %d). Use WASD to move. Press 'q' to quit.", heroX, heroY);
+                renderer.clear();
+                renderer.drawText(0, 0, status);
+                renderer.drawText(0, 1, "HP: 65");
+                renderer.drawMap(map, 0, 2, 0, 0, map.getWidth(), map.getHeight());
+                renderer.drawText(0, 22, "Move: ");
+                renderer.setCursor(6, 22);
+                renderer.present();
+            }
+        });
+        return Sample{frames, ns};
+    });
+    suite.checksum += sink.bytes;
+}
+
+void benchSpawn(BenchSuite& suite) {
+    for (int percent : { 1, 10, 50, 90 }) {
+        uint64_t seed = 1;
+        suite.run("spawn/density_" + std::to_string(percent), [&] {
+            GameOptions options;
+            options.mapWidth = 256;
+            options.mapHeight = 256;
+            options.headless = true;
+            options.seed = seed++;
+            GameManager game(options);
+            game.setPlayerPosition(2, 2);
+            int count = int(game.getMap().countOf(TileType::EMPTY) * size_t(percent) / 100);
+            double ns = elapsedNs([&] { game.spawnEnemies(count); });
+            suite.checksum += game.getEnemies().size();
+            return Sample{uint64_t(count), ns};
+        });
+    }
+}
+
+// Plays a scripted game to `moves` exploration moves; the script fights one round and runs
+// whenever an enemy catches the hero.
+Sample walk(BenchSuite& suite, int enemies, uint64_t moves) {
+    GameOptions options;
+    options.mapWidth = 120;
+    options.mapHeight = 60;
+    options.enemyCount = enemies;
+    options.headless = true;
+    options.seed = 1;
+    options.maxMoves = moves;
+    ScriptedInput input("3\n\n d 1 4 d 1 4 d 1 4 s 1 4 s 1 4 a 1 4 a 1 4 a 1 4 w 1 4 w 1 4 ", true);
+    GameManager game(options, &input);
+    double ns = elapsedNs([&] { game.runGame(); });
+    suite.checksum += game.stateHash();
+    return Sample{std::max<uint64_t>(game.getMovesProcessed(), 1), ns};
+}
+
+void benchExplore(BenchSuite& suite) {
+    suite.run("explore/walk", [&] { return walk(suite, 0, 20000); });
+    suite.run("explore/walk_300_enemies", [&] { return walk(suite, 300, 20000); });
+}
+
+// Wandering enemies at 10% density on a 1024 x 1024 map, on every core; one sample per tick.
+void benchTick(BenchSuite& suite) {
+    GameOptions options;
+    options.mapWidth = 1024;
+    options.mapHeight = 1024;
+    options.headless = true;
+    options.seed = 1;
+    options.huntRadius = 0;
+    options.roam = true;
+    options.interestRadius = 0;
+    options.tickThreads = int(std::max(std::thread::hardware_concurrency(), 1u));
+    GameManager game(options);
+    game.spawnEnemies(int(game.getMap().countOf(TileType::EMPTY) / 10));
+    suite.run("tick/roam_1024", [&] {
+        const uint64_t ticks = 4;
+        double ns = elapsedNs([&] {
+            for (uint64_t i = 0; i < ticks; ++i) game.tickEnemies(false);
+        });
+        suite.checksum += game.getEnemies().size();
+        return Sample{ticks, ns};
+    });
+}
+
+// The same density on a 4096 x 4096 map with the default interest radius, so only the regions
+// around the hero move; this should cost about the same per tick at any map size.
+void benchTickInterest(BenchSuite& suite) {
+    GameOptions options;
+    options.mapWidth = 4096;
+    options.mapHeight = 4096;
+    options.headless = true;
+    options.seed = 1;
+    options.huntRadius = 0;
+    options.roam = true;
+    GameManager game(options);
+    game.spawnEnemies(int(game.getMap().countOf(TileType::EMPTY) / 10));
+    suite.run("tick/roam_interest_4096", [&] {
+        const uint64_t ticks = 64;
+        double ns = elapsedNs([&] {
+            for (uint64_t i = 0; i < ticks; ++i) game.tickEnemies(false);
+        });
+        suite.checksum += game.getEnemies().size();
+        return Sample{ticks, ns};
+    });
+}
+
+// Every ability in turn, applied outside a game the way an AI would when weighing its options.
+void benchAbilities(BenchSuite& suite) {
+    ArenaPtr<Character> user = makeHero(3);
+    ArenaPtr<Character> target = makeHero(4);
+    suite.run("ability/apply", [&] {
+        const uint64_t uses = 1 << 16;
+        double ns = elapsedNs([&] {
+            for (uint64_t i = 0; i < uses; ++i) {
+                AbilityUse use{ AbilityId(i % ABILITY_COUNT), user.get(), target.get(), 10 };
+                applyAbility(use);
+                suite.checksum += uint64_t(target->getHealth());
+                target->restoreHealth(50, 55);
+                user->restoreHealth(120, 150);
+            }
+        });
+        return Sample{uses, ns};
+    });
+}
+
+// One enemy decision with the lookahead the --boss-search option uses: a Witch, halfway
+// through a fight with Kahray, thinking 100,000 simulated turns ahead.
+void benchLookahead(BenchSuite& suite) {
+    CombatLookahead search(KAHRAY_ABILITIES, ENEMY_KINDS[static_cast<int>(EnemyKind::WITCH)].abilities);
+    CombatState state{ { 70, 150 }, { 40, 65 } };
+    suite.run("ai/boss_decision_100k", [&] {
+        const uint64_t decisions = 4;
+        double ns = elapsedNs([&] {
+            for (uint64_t i = 0; i < decisions; ++i) suite.checksum += uint64_t(search.choose(state, 100000));
+        });
+        suite.checksum += search.lastTurns();
+        return Sample{decisions, ns};
+    });
+}
+
+// Each batch plays a fixed run of duels through GameManager::startCombat, the same way the
+// balance simulator does, with a seed per batch so every run times the same fights.
+void benchCombat(BenchSuite& suite) {
+    for (int hero = 1; hero <= CombatSimulator::HERO_COUNT; ++hero) {
+        std::string heroName(makeHero(hero)->getName());
+        for (int kind = 0; kind < ENEMY_KIND_COUNT; ++kind) {
+            uint64_t batchNumber = 0;
+            suite.run("combat/" + heroName + "_vs_" + std::string(nameOf(ENEMY_KINDS[kind].name)), [&] {
+                const uint64_t duels = 256;
+                DuelPolicy policy(++batchNumber);
+                GameOptions options;
+                options.mapWidth = 5;
+                options.mapHeight = 5;
+                options.headless = true;
+                double ns = elapsedNs([&] {
+                    for (uint64_t t = 0; t < duels; ++t) {
+                        options.seed = policy.rng.next() | 1;
+                        GameManager game(options, &policy);
+                        game.setCombatObserver(&policy);
+                        game.setPlayer(makeHero(hero, game.getArena().resource()));
+                        game.setPlayerPosition(2, 2);
+                        game.placeEnemy(3, 2, static_cast<EnemyKind>(kind));
+                        game.startCombat(3, 2);
+                        suite.checksum += uint64_t(policy.rounds);
+                    }
+                });
+                return Sample{duels, ns};
+            });
+        }
+    }
+}
+
+void printBenchUsage() {
+    std::cout << "Usage: ankr-bench [options]\n"
+              << "  --filter TEXT       run only the cases whose name contains TEXT\n"
+              << "  --min-time S        seconds to spend on each case (default 0.5)\n"
+              << "  --out FILE          write the JSON results to FILE instead of stdout\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string filter;
+    std::string outPath;
+    double minTime = 0.5;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "--filter" && hasValue) {
+            filter = args[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            minTime = std::max(std::stod(args[++i]), 0.0);
+        } else if (arg == "--out" && hasValue) {
+            outPath = args[++i];
+        } else {
+            printBenchUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    BenchSuite suite(minTime, filter);
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    std::cerr << "Running benchmarks" << (filter.empty() ? "" : " matching " + filter) << std::endl;
+    benchMap(suite);
+    benchRender(suite);
+    benchSpawn(suite);
+    benchExplore(suite);
+    benchTick(suite);
+    benchTickInterest(suite);
+    benchAbilities(suite);
+    benchLookahead(suite);
+    benchCombat(suite);
+    MessageLog::sync();
+
+    if (outPath.empty()) {
+        suite.writeJson(std::cout);
+        return 0;
+    }
+    std::ofstream out(outPath);
+    if (!out) {
+        std::cerr << "Cannot write " << outPath << std::endl;
+        return 1;
+    }
+    suite.writeJson(out);
+    return 0;
+}
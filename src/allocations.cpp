@@ -0,0 +1,65 @@
+#include "ankr.h"
+
+// Every heap allocation is counted per thread, so --check-alloc can tell what allocates. Each
+// form of operator new is replaced: plain, array, nothrow and aligned. This file is only built
+// with -DANKR_COUNT_ALLOCS=ON, so other builds keep the standard allocator.
+uint64_t& heapAllocations() {
+    thread_local uint64_t count = 0;
+    return count;
+}
+
+namespace {
+
+void* countedAlloc(size_t size) noexcept {
+    ++heapAllocations();
+    return std::malloc(size ? size : 1);
+}
+
+void* countedAlignedAlloc(size_t size, std::align_val_t align) noexcept {
+    ++heapAllocations();
+    size_t alignment = size_t(align);
+    size = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, size);
+#endif
+}
+
+void alignedFree(void* block) noexcept {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+void* orThrow(void* block) {
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+} // namespace
+
+void* operator new(size_t size) { return orThrow(countedAlloc(size)); }
+void* operator new[](size_t size) { return orThrow(countedAlloc(size)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new(size_t size, std::align_val_t align) { return orThrow(countedAlignedAlloc(size, align)); }
+void* operator new[](size_t size, std::align_val_t align) { return orThrow(countedAlignedAlloc(size, align)); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlignedAlloc(size, align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlignedAlloc(size, align); }
+
+// Kept out of line so the compiler doesn't pair the inlined free() with operator new.
+[[gnu::noinline]] void operator delete(void* block) noexcept { std::free(block); }
+[[gnu::noinline]] void operator delete(void* block, size_t) noexcept { std::free(block); }
+[[gnu::noinline]] void operator delete[](void* block) noexcept { std::free(block); }
+[[gnu::noinline]] void operator delete[](void* block, size_t) noexcept { std::free(block); }
+[[gnu::noinline]] void operator delete(void* block, const std::nothrow_t&) noexcept { std::free(block); }
+[[gnu::noinline]] void operator delete[](void* block, const std::nothrow_t&) noexcept { std::free(block); }
+[[gnu::noinline]] void operator delete(void* block, std::align_val_t) noexcept { alignedFree(block); }
+[[gnu::noinline]] void operator delete(void* block, size_t, std::align_val_t) noexcept { alignedFree(block); }
+[[gnu::noinline]] void operator delete[](void* block, std::align_val_t) noexcept { alignedFree(block); }
+[[gnu::noinline]] void operator delete[](void* block, size_t, std::align_val_t) noexcept { alignedFree(block); }
+[[gnu::noinline]] void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(block); }
+[[gnu::noinline]] void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(block); }
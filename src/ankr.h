@@ -0,0 +1,4655 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <filesystem>
+#include <type_traits>
+#include <cstring>
+#include <string_view>
+#include <memory_resource>
+
+#ifdef ANKR_COUNT_ALLOCS
+// Heap allocations made so far on this thread; see allocations.cpp.
+uint64_t& heapAllocations();
+#endif
+
+#ifdef _WIN32
+#include <conio.h>
+// The console hands keys over unbuffered already. Waits up to `timeoutMs` (-1: forever) for
+// keys and reads every one that is waiting; returns how many, 0 on timeout.
+inline int readTerminal(char* buf, int capacity, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!_kbhit()) {
+        if (timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline) return 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    int count = 0;
+    while (count < capacity && _kbhit()) buf[count++] = char(_getch());
+    return count;
+}
+
+class RawTerminal {
+public:
+    static void enable() {}
+    static bool isActive() { return false; }
+};
+
+#else
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <csignal>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+// Keeps stdin out of line mode, without echo, from the first read until the process ends.
+// The saved settings come back at exit and on the signals that would otherwise leave the
+// shell without echo; Ctrl-C still raises SIGINT.
+class RawTerminal {
+private:
+    static inline termios saved = {};
+    static inline volatile sig_atomic_t active = 0;
+
+    static void restore() {
+        if (active) tcsetattr(0, TCSANOW, &saved);
+        active = 0;
+    }
+
+    static void onSignal(int sig) {
+        restore();
+        std::signal(sig, SIG_DFL);
+        std::raise(sig);
+    }
+
+public:
+    static void enable() {
+        static bool tried = false;
+        if (tried) return;
+        tried = true;
+        if (!isatty(0) || tcgetattr(0, &saved) < 0) return;
+        termios raw = saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(0, TCSANOW, &raw) < 0) {
+            perror("tcsetattr ICANON");
+            return;
+        }
+        active = 1;
+        std::atexit(restore);
+        for (int sig : { SIGINT, SIGTERM, SIGHUP, SIGQUIT }) std::signal(sig, onSignal);
+    }
+
+    static bool isActive() { return active != 0; }
+};
+
+// Waits up to `timeoutMs` (-1: forever) for stdin and takes everything that has arrived in
+// one read. Returns the byte count, 0 on timeout and -1 at end of input.
+inline int readTerminal(char* buf, int capacity, int timeoutMs) {
+    pollfd stdinPoll = { 0, POLLIN, 0 };
+    int ready = poll(&stdinPoll, 1, timeoutMs);
+    if (ready == 0 || (ready < 0 && errno == EINTR)) return 0;
+    if (ready < 0) return -1;
+    ssize_t count = read(0, buf, size_t(capacity));
+    return count > 0 ? int(count) : -1;
+}
+#endif
+
+#ifndef ANKR_LOG
+#define ANKR_LOG 3
+#endif
+
+// Somewhere other than the terminal for frames and game text, such as a network session.
+class TextSink {
+public:
+    virtual ~TextSink() {}
+    virtual void write(const char* data, size_t size) = 0;
+};
+
+// Game text goes through here instead of straight to std::cout. Callers post a format and its
+// arguments into a lock-free ring, and a writer thread formats whatever has piled up and
+// writes it with one fwrite and flush. Messages above ANKR_LOG are compiled out; those above
+// the runtime verbosity cost one relaxed load.
+class MessageLog {
+public:
+    // NOTICE is prompts, menus and results, EVENT is what happens in a fight, DETAIL is
+    // per-enemy chatter.
+    enum Level { SILENT = 0, NOTICE, EVENT, DETAIL };
+    static constexpr int MAX_ARGS = 4;
+
+private:
+    static constexpr uint64_t CAPACITY = 1024;
+    static constexpr size_t TEXT_SIZE = 32;
+
+    // Arguments are copied in as they are: numbers as numbers, std::strings into the record
+    // (cut to TEXT_SIZE - 1 characters), and C strings and string_views by pointer, so those
+    // must be literals or static tables such as NAMES.
+    struct Record {
+        std::atomic<uint64_t> sequence;
+        const char* format;
+        uint8_t count;
+        uint8_t kinds[MAX_ARGS];
+        int64_t numbers[MAX_ARGS];
+        const char* texts[MAX_ARGS];
+        char copies[2][TEXT_SIZE];
+    };
+    enum ArgKind : uint8_t { NUMBER, TEXT, COPY, VIEW };
+
+    static inline std::atomic<int> verbosity{ DETAIL };
+    static inline std::atomic<MessageLog*> running{ nullptr };
+    static inline std::atomic<std::FILE*> output{ nullptr };
+
+    std::unique_ptr<Record[]> slots;
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> batches{ 0 };
+    std::atomic<bool> sleeping{ false };
+    std::atomic<bool> stopping{ false };
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread writer;
+
+    MessageLog() : slots(new Record[CAPACITY]) {
+        for (uint64_t i = 0; i < CAPACITY; ++i) slots[i].sequence.store(i, std::memory_order_relaxed);
+        writer = std::thread([this] { writerLoop(); });
+        running.store(this, std::memory_order_release);
+    }
+
+    ~MessageLog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping.store(true);
+        }
+        wake.notify_one();
+        writer.join();
+        running.store(nullptr, std::memory_order_release);
+    }
+
+    static MessageLog& instance() {
+        static MessageLog log;
+        return log;
+    }
+
+    // Producers only take the lock when the writer has gone to sleep on an empty ring.
+    void wakeWriter() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    template <typename T>
+    static void put(Record& record, int& copies, const T& value) {
+        int i = record.count++;
+        if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            record.kinds[i] = NUMBER;
+            record.numbers[i] = int64_t(value);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            record.kinds[i] = COPY;
+            record.numbers[i] = copies;
+            size_t length = std::min(value.size(), TEXT_SIZE - 1);
+            std::memcpy(record.copies[copies], value.data(), length);
+            record.copies[copies++][length] = '\0';
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+            record.kinds[i] = VIEW;
+            record.texts[i] = value.data();
+            record.numbers[i] = int64_t(value.size());
+        } else {
+            record.kinds[i] = TEXT;
+            record.texts[i] = value;
+        }
+    }
+
+    template <typename... Args>
+    static void fill(Record& record, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+        static_assert((0 + ... + std::is_same_v<Args, std::string>) <= 2, "at most two std::string log arguments");
+        record.format = format;
+        record.count = 0;
+        [[maybe_unused]] int copies = 0;
+        (put(record, copies, args), ...);
+    }
+
+    template <typename... Args>
+    void push(const char* format, const Args&... args) {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        Record* record;
+        for (;;) {
+            record = &slots[pos & (CAPACITY - 1)];
+            int64_t lag = int64_t(record->sequence.load(std::memory_order_acquire) - pos);
+            if (lag == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (lag < 0) {
+                // Full: let the writer catch up rather than drop a line.
+                wakeWriter();
+                std::this_thread::yield();
+                pos = head.load(std::memory_order_relaxed);
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        fill(*record, format, args...);
+        record->sequence.store(pos + 1, std::memory_order_release);
+        wakeWriter();
+    }
+
+    // Each "{}" in the format takes the next argument.
+    static void formatRecord(const Record& record, std::string& out) {
+        int next = 0;
+        for (const char* c = record.format; *c; ++c) {
+            if (c[0] != '{' || c[1] != '}' || next >= record.count) {
+                out += *c;
+                continue;
+            }
+            switch (record.kinds[next]) {
+                case NUMBER: {
+                    char digits[24];
+                    int length = std::snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(record.numbers[next]));
+                    out.append(digits, size_t(length));
+                    break;
+                }
+                case TEXT: out += record.texts[next]; break;
+                case COPY: out += record.copies[record.numbers[next]]; break;
+                case VIEW: out.append(record.texts[next], size_t(record.numbers[next])); break;
+            }
+            ++next;
+            ++c;
+        }
+    }
+
+    void writerLoop() {
+        std::string batch;
+        batch.reserve(64 * 1024);
+        uint64_t tail = 0;
+        for (;;) {
+            uint64_t taken = 0;
+            for (;;) {
+                Record& record = slots[tail & (CAPACITY - 1)];
+                if (record.sequence.load(std::memory_order_acquire) != tail + 1) break;
+                formatRecord(record, batch);
+                record.sequence.store(tail + CAPACITY, std::memory_order_release);
+                ++tail;
+                ++taken;
+            }
+            if (taken) {
+                std::FILE* target = output.load(std::memory_order_acquire);
+                if (!target) target = stdout;
+                std::fwrite(batch.data(), 1, batch.size(), target);
+                std::fflush(target);
+                batch.clear();
+                batches.fetch_add(1, std::memory_order_relaxed);
+                written.store(tail, std::memory_order_release);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (slots[tail & (CAPACITY - 1)].sequence.load(std::memory_order_acquire) == tail + 1) {
+                sleeping.store(false);
+                continue;
+            }
+            if (stopping.load()) return;
+            wake.wait(lock, [this] { return !sleeping.load() || stopping.load(); });
+            sleeping.store(false);
+        }
+    }
+
+public:
+    static void setVerbosity(int level) { verbosity.store(level, std::memory_order_relaxed); }
+    static int getVerbosity() { return verbosity.load(std::memory_order_relaxed); }
+
+    template <int LEVEL, typename... Args>
+    static void post(const char* format, const Args&... args) {
+        if constexpr (LEVEL <= ANKR_LOG) {
+            if (LEVEL > verbosity.load(std::memory_order_relaxed)) return;
+            if (TextSink* sink = capture()) {
+                thread_local std::string text;
+                Record record;
+                fill(record, format, args...);
+                text.clear();
+                formatRecord(record, text);
+                sink->write(text.data(), text.size());
+            } else {
+                instance().push(format, args...);
+            }
+        }
+    }
+
+    // While set, posts from this thread are formatted on the spot and go to the sink instead
+    // of the writer thread. Game sessions served over the network use this.
+    static TextSink*& capture() {
+        thread_local TextSink* sink = nullptr;
+        return sink;
+    }
+
+    // Blocks until everything posted so far has been written. Anything else that writes to
+    // the terminal, or waits on the player, calls this first so lines stay in order.
+    static void sync() {
+        MessageLog* log = running.load(std::memory_order_acquire);
+        if (!log) return;
+        uint64_t target = log->head.load(std::memory_order_acquire);
+        while (log->written.load(std::memory_order_acquire) < target) {
+            log->wakeWriter();
+            std::this_thread::yield();
+        }
+    }
+
+    // Where the writer sends text; null means stdout.
+    static void setOutput(std::FILE* file) {
+        sync();
+        output.store(file, std::memory_order_release);
+    }
+
+    static uint64_t getBatches() {
+        MessageLog* log = running.load(std::memory_order_acquire);
+        return log ? log->batches.load(std::memory_order_relaxed) : 0;
+    }
+};
+
+// Shorthand for MessageLog::post.
+template <int LEVEL, typename... Args>
+void logMessage(const char* format, const Args&... args) {
+    MessageLog::post<LEVEL>(format, args...);
+}
+
+#ifndef ANKR_PROFILE
+#define ANKR_PROFILE 1
+#endif
+
+// Where the time goes in the game loop: latency histograms for each phase of a move or
+// combat round, plus running totals. Histograms are log-linear like HDR histograms, 16
+// buckets per power of two, so any value is known to within about 6%. Each thread records
+// into its own shard with plain relaxed stores, so recording takes no lock and no atomic
+// read-modify-write; report() sums the shards. Built with ANKR_PROFILE=0, every call is empty.
+class Profiler {
+public:
+    enum Phase { INPUT, MOVE, ENEMIES, RENDER, ROUND, PHASE_COUNT };
+    enum Counter { TILES_WRITTEN, ENEMIES_PROCESSED, BYTES_RENDERED, COUNTER_COUNT };
+
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    struct Shard {
+        std::atomic<uint64_t> buckets[PHASE_COUNT][BUCKETS] = {};
+        std::atomic<uint64_t> maxNs[PHASE_COUNT] = {};
+        std::atomic<uint64_t> counters[COUNTER_COUNT] = {};
+    };
+
+    static inline std::mutex shardsMutex;
+    static inline std::vector<std::unique_ptr<Shard>> shards;
+
+    // Only the owning thread writes a shard, so a load and a store are enough.
+    static void bump(std::atomic<uint64_t>& value, uint64_t by) {
+        value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static Shard& shard() {
+        thread_local Shard* mine = nullptr;
+        if (!mine) {
+            std::lock_guard<std::mutex> lock(shardsMutex);
+            shards.push_back(std::make_unique<Shard>());
+            mine = shards.back().get();
+        }
+        return *mine;
+    }
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return int(ns);
+        int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+        return ((shift + 1) << SUB_BITS) + int((ns >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // The largest value that lands in `bucket`.
+    static uint64_t bucketTop(int bucket) {
+        if (bucket < SUB_BUCKETS) return uint64_t(bucket);
+        int shift = (bucket >> SUB_BITS) - 1;
+        return ((uint64_t(SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) + 1) << shift) - 1;
+    }
+
+public:
+#if ANKR_PROFILE
+    using Stamp = std::chrono::steady_clock::time_point;
+
+    static Stamp now() { return std::chrono::steady_clock::now(); }
+
+    // Records the time since `start` against `phase`.
+    static void record(Phase phase, Stamp start) {
+        uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now() - start).count());
+        Shard& s = shard();
+        bump(s.buckets[phase][bucketOf(ns)], 1);
+        if (ns > s.maxNs[phase].load(std::memory_order_relaxed)) s.maxNs[phase].store(ns, std::memory_order_relaxed);
+    }
+
+    static void count(Counter counter, uint64_t by) {
+        if (by) bump(shard().counters[counter], by);
+    }
+#else
+    struct Stamp {};
+    static Stamp now() { return {}; }
+    static void record(Phase, Stamp) {}
+    static void count(Counter, uint64_t) {}
+#endif
+
+    static bool enabled() { return ANKR_PROFILE != 0; }
+
+    // Prints count, p50, p99 and max for every phase that saw any samples, then the totals.
+    static void report(std::ostream& out) {
+        static const char* phaseNames[PHASE_COUNT] = { "input", "move", "enemies", "render", "combat round" };
+        static const char* counterNames[COUNTER_COUNT] = { "tiles written", "enemies processed", "bytes rendered" };
+        if (!enabled()) {
+            out << "Profiling was compiled out (ANKR_PROFILE=0)." << std::endl;
+            return;
+        }
+        std::vector<uint64_t> merged(BUCKETS);
+        uint64_t totals[COUNTER_COUNT] = {};
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-14s %10s %10s %10s %10s\n", "phase (us)", "count", "p50", "p99", "max");
+        out << line;
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            std::fill(merged.begin(), merged.end(), 0);
+            uint64_t samples = 0, maxNs = 0;
+            for (const auto& s : shards) {
+                for (int b = 0; b < BUCKETS; ++b) merged[b] += s->buckets[p][b].load(std::memory_order_relaxed);
+                maxNs = std::max(maxNs, s->maxNs[p].load(std::memory_order_relaxed));
+            }
+            for (uint64_t n : merged) samples += n;
+            if (samples == 0) continue;
+            auto percentile = [&](double q) {
+                uint64_t rank = uint64_t(std::ceil(q * double(samples))) - 1, seen = 0;
+                for (int b = 0; b < BUCKETS; ++b) {
+                    seen += merged[b];
+                    if (seen > rank) return std::min(bucketTop(b), maxNs);
+                }
+                return maxNs;
+            };
+            std::snprintf(line, sizeof(line), "%-14s %10llu %10.2f %10.2f %10.2f\n", phaseNames[p],
+                          (unsigned long long)samples, percentile(0.5) / 1e3, percentile(0.99) / 1e3, maxNs / 1e3);
+            out << line;
+        }
+        for (const auto& s : shards) {
+            for (int c = 0; c < COUNTER_COUNT; ++c) totals[c] += s->counters[c].load(std::memory_order_relaxed);
+        }
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            std::snprintf(line, sizeof(line), "%-18s %12llu\n", counterNames[c], (unsigned long long)totals[c]);
+            out << line;
+        }
+        out.flush();
+    }
+};
+
+// Where keypresses and typed numbers come from. Prompts go to the MessageLog; only the
+// reading goes through here, so a script can stand in for the player.
+class InputSource {
+public:
+    static constexpr char END_OF_INPUT = '\0';
+    // What readKeyOrTick returns when the deadline comes before a key.
+    static constexpr char TICK = '\x01';
+
+    virtual ~InputSource() {}
+    virtual char readKey() = 0;
+    // The next key, or TICK once `deadline` has passed. Sources that are not driven by the
+    // clock never tick.
+    virtual char readKeyOrTick([[maybe_unused]] std::chrono::steady_clock::time_point deadline) { return readKey(); }
+    // Whether another key is already waiting, so drawing can wait until a batch is handled.
+    virtual bool hasPendingKey() const { return false; }
+    // `lo` and `hi` describe what the prompt expects; sources are free to return anything.
+    virtual int readInt(int lo, int hi) = 0;
+    virtual void waitForEnter() = 0;
+    virtual bool exhausted() const = 0;
+};
+
+// Reads the keyboard in batches: each wakeup drains everything the terminal has buffered, so
+// a held key is handled press by press instead of one press per frame.
+class TerminalInput : public InputSource {
+private:
+    std::deque<char> pending;
+    bool ended = false;
+
+    // Waits up to `timeoutMs` for more input; false on timeout or end of input.
+    bool fill(int timeoutMs) {
+        RawTerminal::enable();
+        MessageLog::sync();
+        char buf[256];
+        int count = readTerminal(buf, int(sizeof(buf)), timeoutMs);
+        if (count < 0) ended = true;
+        for (int i = 0; i < count; ++i) {
+            // Other control characters (Ctrl-A would read as a tick) are dropped.
+            unsigned char c = static_cast<unsigned char>(buf[i]);
+            if (c >= 0x20 || c == '\n' || c == '\r' || c == '\b') pending.push_back(buf[i]);
+        }
+        return count > 0;
+    }
+
+    bool nextChar(char& c) {
+        while (pending.empty()) {
+            if (ended) return false;
+            fill(-1);
+        }
+        c = pending.front();
+        pending.pop_front();
+        return true;
+    }
+
+    // Line editing the terminal no longer does for us: echo and backspace.
+    bool readLine(std::string& line) {
+        line.clear();
+        bool echo = RawTerminal::isActive();
+        char c;
+        while (nextChar(c)) {
+            if (c == '\n' || c == '\r') {
+                if (echo) std::cout << std::endl;
+                return true;
+            }
+            if (c == '\b' || c == 0x7F) {
+                if (!line.empty()) {
+                    line.pop_back();
+                    if (echo) std::cout << "\b \b" << std::flush;
+                }
+            } else {
+                line += c;
+                if (echo) std::cout << c << std::flush;
+            }
+        }
+        return false;
+    }
+
+public:
+    char readKey() override {
+        char key;
+        return nextChar(key) ? key : END_OF_INPUT;
+    }
+
+    char readKeyOrTick(std::chrono::steady_clock::time_point deadline) override {
+        for (;;) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) return TICK;
+            if (!pending.empty()) break;
+            if (ended) return END_OF_INPUT;
+            fill(int(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1);
+        }
+        char key = pending.front();
+        pending.pop_front();
+        return key;
+    }
+
+    bool hasPendingKey() const override { return !pending.empty(); }
+
+    int readInt(int lo, int) override {
+        std::string line;
+        if (!readLine(line)) return lo - 1;
+        try {
+            return std::stoi(line);
+        } catch (const std::exception&) {
+            return lo - 1;
+        }
+    }
+
+    void waitForEnter() override {
+        std::string line;
+        readLine(line);
+    }
+
+    bool exhausted() const override { return ended && pending.empty(); }
+};
+
+// Replays a script: keys are read one character at a time, numbers as whole tokens, and
+// '#' starts a comment that runs to the end of the line. With `loop` set the script
+// starts over when it runs out.
+class ScriptedInput : public InputSource {
+private:
+    std::string script;
+    size_t pos = 0;
+    bool loop;
+    bool ended = false;
+
+    bool skipBlank() {
+        for (int pass = 0; pass < 2; ++pass) {
+            while (pos < script.size()) {
+                char c = script[pos];
+                if (c == '#') {
+                    while (pos < script.size() && script[pos] != '\n') ++pos;
+                } else if (std::isspace(static_cast<unsigned char>(c))) {
+                    ++pos;
+                } else {
+                    return true;
+                }
+            }
+            if (!loop) break;
+            pos = 0;
+        }
+        ended = true;
+        return false;
+    }
+
+public:
+    ScriptedInput(std::string text, bool loopScript = false)
+        : script(std::move(text)), loop(loopScript) {}
+
+    char readKey() override {
+        if (!skipBlank()) return END_OF_INPUT;
+        return script[pos++];
+    }
+
+    int readInt(int lo, int) override {
+        if (!skipBlank()) return lo - 1;
+        size_t start = pos;
+        if (script[pos] == '-' || script[pos] == '+') ++pos;
+        int value = 0;
+        bool digits = false;
+        while (pos < script.size() && std::isdigit(static_cast<unsigned char>(script[pos]))) {
+            value = value * 10 + (script[pos++] - '0');
+            digits = true;
+        }
+        if (!digits) {
+            pos = start + 1;
+            return lo - 1;
+        }
+        return script[start] == '-' ? -value : value;
+    }
+
+    void waitForEnter() override {}
+
+    bool exhausted() const override { return ended; }
+};
+
+// xoshiro256** : 32 bytes of state, a few cycles per draw. Usable with <random> distributions,
+// but below()/range()/fillBelow() are cheaper for the small ranges the game needs.
+class Rng {
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    using result_type = uint64_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint64_t>::max(); }
+
+    explicit Rng(uint64_t seed = 1) {
+        reseed(seed);
+    }
+
+    void reseed(uint64_t seed) {
+        for (auto& word : s) {
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    result_type operator()() { return next(); }
+
+    // Uniform in [0, bound), unbiased (Lemire's multiply-and-reject).
+    uint32_t below(uint32_t bound) {
+        uint64_t m = (next() >> 32) * bound;
+        uint32_t low = uint32_t(m);
+        if (low < bound) {
+            uint32_t threshold = uint32_t(-bound) % bound;
+            while (low < threshold) {
+                m = (next() >> 32) * bound;
+                low = uint32_t(m);
+            }
+        }
+        return uint32_t(m >> 32);
+    }
+
+    // Uniform in [lo, hi].
+    int range(int lo, int hi) {
+        return lo + int(below(uint32_t(hi - lo) + 1));
+    }
+
+    void fillBelow(uint32_t* out, size_t count, uint32_t bound) {
+        for (size_t i = 0; i < count; ++i) out[i] = below(bound);
+    }
+
+    // Raw generator state, so a saved game continues the same sequence.
+    void getState(uint64_t out[4]) const { std::copy(s, s + 4, out); }
+    void setState(const uint64_t in[4]) { std::copy(in, in + 4, s); }
+};
+
+// Hands out independent Rng streams derived from one master seed, so a run can be replayed
+// from that seed alone. Streams are keyed by a caller-chosen id: a fixed purpose, an entity,
+// or an (entity, tick) pair when the order draws happen in must not matter.
+class RngService {
+private:
+    uint64_t masterSeed;
+
+public:
+    enum Stream : uint64_t {
+        SPAWN = 1,
+        COMBAT = 2,
+        SIMULATION = 3,
+        WORLD = 4,
+        ROAM = 5,
+        THREAD_BASE = uint64_t(1) << 32,
+    };
+
+    static uint64_t mix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    explicit RngService(uint64_t seed) : masterSeed(seed) {}
+
+    static uint64_t seedFromClock() {
+        return uint64_t(std::chrono::high_resolution_clock::now().time_since_epoch().count()) | 1;
+    }
+
+    uint64_t getMasterSeed() const { return masterSeed; }
+
+    uint64_t streamSeed(uint64_t streamId) const {
+        return mix(masterSeed ^ mix(streamId));
+    }
+
+    Rng stream(uint64_t streamId) const {
+        return Rng(streamSeed(streamId));
+    }
+
+    Rng entityStream(uint64_t entityId, uint64_t tick) const {
+        return Rng(mix(streamSeed(entityId) ^ mix(tick)));
+    }
+};
+
+// Append-only binary record of a run: every input the game reads plus what it did with them
+// (damage, heals, spawns, hero positions). Records are a type byte followed by LEB128 varints;
+// signed values are zigzag encoded and positions are deltas from the previous one of their
+// kind, so most records take 2-4 bytes. Writes go to a 64 KiB buffer flushed with one fwrite.
+// Without a file the journal is kept in memory, which is what replays compare against.
+class EventJournal {
+public:
+    enum Record : uint8_t {
+        GAME_START = 1,
+        KEY,
+        NUMBER,
+        ENTER,
+        EXHAUSTED,
+        HERO_AT,
+        DAMAGE,
+        HEAL,
+        SPAWN,
+        GAME_END,
+        TICK,
+    };
+
+    static constexpr char MAGIC[8] = { 'A', 'N', 'K', 'R', 'J', 'R', 'N', 'L' };
+    static constexpr uint64_t VERSION = 6;
+
+private:
+    static constexpr size_t FLUSH_AT = 64 * 1024;
+
+    std::FILE* file = nullptr;
+    std::vector<uint8_t> buffer;
+    uint64_t records = 0;
+    int heroX = 0;
+    int heroY = 0;
+    int spawnX = 0;
+    int spawnY = 0;
+
+    void begin(Record type) {
+        if (file && buffer.size() >= FLUSH_AT) flush();
+        buffer.push_back(type);
+        ++records;
+    }
+
+    void putSigned(int64_t value) {
+        putVarint((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+    }
+
+public:
+    // Writes to `path`, or keeps the journal in memory if `path` is empty.
+    explicit EventJournal(const std::string& path = "") {
+        buffer.reserve(FLUSH_AT + 64);
+        if (!path.empty()) file = std::fopen(path.c_str(), "wb");
+        buffer.insert(buffer.end(), MAGIC, MAGIC + 8);
+        putVarint(VERSION);
+    }
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    ~EventJournal() {
+        flush();
+        if (file) std::fclose(file);
+    }
+
+    bool hasFile() const { return file != nullptr; }
+
+    // The journal the running game on this thread writes to, if any.
+    static EventJournal*& current() {
+        thread_local EventJournal* journal = nullptr;
+        return journal;
+    }
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(uint8_t(value) | 0x80);
+            value >>= 7;
+        }
+        buffer.push_back(uint8_t(value));
+    }
+
+    void flush() {
+        if (!file || buffer.empty()) return;
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+        std::fflush(file);
+        buffer.clear();
+    }
+
+    void gameStart(uint64_t seed) {
+        begin(GAME_START);
+        putVarint(seed);
+        heroX = heroY = spawnX = spawnY = 0;
+    }
+
+    void key(char c) { begin(KEY); buffer.push_back(uint8_t(c)); }
+    void number(int value) { begin(NUMBER); putSigned(value); }
+    void enter() { begin(ENTER); }
+    void exhausted() { begin(EXHAUSTED); }
+    void tick() { begin(TICK); }
+
+    void heroAt(int x, int y) {
+        begin(HERO_AT);
+        putSigned(x - heroX);
+        putSigned(y - heroY);
+        heroX = x;
+        heroY = y;
+    }
+
+    // `who` identifies the character by name (see Character's journal id).
+    void damage(uint32_t who, int amount, int healthAfter) {
+        begin(DAMAGE);
+        putVarint(who);
+        putSigned(amount);
+        putSigned(healthAfter);
+    }
+
+    void heal(uint32_t who, int amount, int healthAfter) {
+        begin(HEAL);
+        putVarint(who);
+        putSigned(amount);
+        putSigned(healthAfter);
+    }
+
+    void spawn(int x, int y, int kind) {
+        begin(SPAWN);
+        putSigned(x - spawnX);
+        putSigned(y - spawnY);
+        putVarint(uint64_t(kind));
+        spawnX = x;
+        spawnY = y;
+    }
+
+    void gameEnd(uint64_t stateHash) {
+        begin(GAME_END);
+        putVarint(stateHash);
+    }
+
+    // Everything not yet flushed; for an in-memory journal, the whole journal.
+    const std::vector<uint8_t>& bytes() const { return buffer; }
+    uint64_t recordCount() const { return records; }
+};
+
+// Reads records back in the order EventJournal wrote them.
+class JournalReader {
+private:
+    const std::vector<uint8_t>& data;
+    size_t pos = 0;
+    bool failed = false;
+
+public:
+    struct Event {
+        EventJournal::Record type;
+        int64_t values[3];
+        size_t offset;
+    };
+
+    explicit JournalReader(const std::vector<uint8_t>& bytes) : data(bytes) {}
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= data.size()) break;
+            uint8_t byte = data[pos++];
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t zigzag() {
+        uint64_t value = varint();
+        return int64_t(value >> 1) ^ -int64_t(value & 1);
+    }
+
+    bool header() {
+        if (data.size() < 8 || !std::equal(EventJournal::MAGIC, EventJournal::MAGIC + 8, data.begin())) return false;
+        pos = 8;
+        return varint() == EventJournal::VERSION && !failed;
+    }
+
+    // False at the end of the journal or on a malformed record. Positions are returned as
+    // stored, i.e. as deltas.
+    bool next(Event& event) {
+        if (failed || pos >= data.size()) return false;
+        event.offset = pos;
+        event.type = static_cast<EventJournal::Record>(data[pos++]);
+        std::fill(event.values, event.values + 3, 0);
+        switch (event.type) {
+            case EventJournal::GAME_START: case EventJournal::GAME_END:
+                event.values[0] = int64_t(varint());
+                break;
+            case EventJournal::KEY:
+                if (pos >= data.size()) return false;
+                event.values[0] = data[pos++];
+                break;
+            case EventJournal::NUMBER:
+                event.values[0] = zigzag();
+                break;
+            case EventJournal::ENTER: case EventJournal::EXHAUSTED: case EventJournal::TICK:
+                break;
+            case EventJournal::HERO_AT:
+                event.values[0] = zigzag();
+                event.values[1] = zigzag();
+                break;
+            case EventJournal::DAMAGE: case EventJournal::HEAL:
+                event.values[0] = int64_t(varint());
+                event.values[1] = zigzag();
+                event.values[2] = zigzag();
+                break;
+            case EventJournal::SPAWN:
+                event.values[0] = zigzag();
+                event.values[1] = zigzag();
+                event.values[2] = int64_t(varint());
+                break;
+            default:
+                failed = true;
+                return false;
+        }
+        return !failed;
+    }
+
+    size_t offset() const { return pos; }
+};
+
+// Passes reads through to another source and journals what they returned. The end of the
+// input is journaled once, right after the read that ran into it, so the journal does not
+// depend on how often anyone asks whether the input is exhausted.
+class RecordingInput : public InputSource {
+private:
+    InputSource& inner;
+    EventJournal& journal;
+    bool ended = false;
+
+    void noteEnd() {
+        if (ended || !inner.exhausted()) return;
+        ended = true;
+        journal.exhausted();
+    }
+
+public:
+    RecordingInput(InputSource& source, EventJournal& target) : inner(source), journal(target) {}
+
+    char readKey() override {
+        char key = inner.readKey();
+        journal.key(key);
+        noteEnd();
+        return key;
+    }
+
+    char readKeyOrTick(std::chrono::steady_clock::time_point deadline) override {
+        char key = inner.readKeyOrTick(deadline);
+        if (key == TICK) {
+            journal.tick();
+        } else {
+            journal.key(key);
+        }
+        noteEnd();
+        return key;
+    }
+
+    bool hasPendingKey() const override { return inner.hasPendingKey(); }
+
+    int readInt(int lo, int hi) override {
+        int value = inner.readInt(lo, hi);
+        journal.number(value);
+        noteEnd();
+        return value;
+    }
+
+    void waitForEnter() override {
+        inner.waitForEnter();
+        journal.enter();
+        noteEnd();
+    }
+
+    bool exhausted() const override { return ended; }
+};
+
+// Hands objects made in a LevelArena back to it: runs the destructor and returns the block
+// to the arena's pools. A default-constructed one goes to the ordinary heap.
+struct ArenaDelete {
+    std::pmr::memory_resource* resource = std::pmr::new_delete_resource();
+    size_t size = 0;
+    size_t align = alignof(std::max_align_t);
+
+    template <typename T>
+    void operator()(T* object) const {
+        object->~T();
+        resource->deallocate(object, size, align);
+    }
+};
+
+template <typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDelete>;
+
+template <typename T, typename... Args>
+ArenaPtr<T> makeIn(std::pmr::memory_resource* resource, Args&&... args) {
+    void* block = resource->allocate(sizeof(T), alignof(T));
+    return ArenaPtr<T>(new (block) T(std::forward<Args>(args)...), ArenaDelete{ resource, sizeof(T), alignof(T) });
+}
+
+// Runs batches of independent tasks, numbered 0 to count - 1, on a fixed set of threads, the
+// calling thread included. Each thread starts on its own contiguous share of the numbers and,
+// once that is used up, takes numbers from the other shares, so a batch where a few tasks are
+// much heavier than the rest (one crowded region, many empty ones) still keeps every thread
+// busy. Taking a number is one fetch_add on the share's counter; nothing is locked while a
+// batch runs.
+class WorkStealingPool {
+private:
+    struct alignas(64) Share {
+        std::atomic<size_t> next{ 0 };
+        size_t end = 0;
+    };
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Share[]> shares;
+    unsigned participants;
+
+    void (*call)(void*, size_t) = nullptr;
+    void* job = nullptr;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    uint64_t batch = 0;
+    unsigned busy = 0;
+    bool stopping = false;
+
+    void work(unsigned self) {
+        for (unsigned k = 0; k < participants; ++k) {
+            Share& share = shares[(self + k) % participants];
+            for (size_t task = share.next.fetch_add(1, std::memory_order_relaxed); task < share.end;
+                 task = share.next.fetch_add(1, std::memory_order_relaxed)) {
+                call(job, task);
+            }
+        }
+    }
+
+    void workerLoop(unsigned self) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                started.wait(lock, [&] { return stopping || batch != seen; });
+                if (stopping) return;
+                seen = batch;
+            }
+            work(self);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) finished.notify_one();
+        }
+    }
+
+public:
+    explicit WorkStealingPool(unsigned threads)
+        : shares(std::make_unique<Share[]>(std::max(threads, 1u))), participants(std::max(threads, 1u)) {
+        for (unsigned i = 1; i < participants; ++i) workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        started.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Calls fn(task) once for every task and returns when all of them are done.
+    template <typename Fn>
+    void run(size_t count, Fn&& fn) {
+        if (participants == 1 || count <= 1) {
+            for (size_t task = 0; task < count; ++task) fn(task);
+            return;
+        }
+        for (unsigned i = 0; i < participants; ++i) {
+            shares[i].next.store(count * i / participants, std::memory_order_relaxed);
+            shares[i].end = count * (i + 1) / participants;
+        }
+        call = [](void* f, size_t task) { (*static_cast<std::remove_reference_t<Fn>*>(f))(task); };
+        job = &fn;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = participants - 1;
+            ++batch;
+        }
+        started.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy == 0; });
+    }
+
+    unsigned size() const { return participants; }
+};
+
+// What one level allocates while it runs: enemy tables, the spatial index, search scratch and
+// the hero. Freed blocks go back to per-size pools, so a level stops touching the heap once
+// its tables have grown, and everything is given back at once when the level ends.
+class LevelArena {
+private:
+    std::pmr::monotonic_buffer_resource blocks;
+    std::pmr::unsynchronized_pool_resource pools;
+
+public:
+    explicit LevelArena(size_t firstBlock = 16 * 1024) : blocks(firstBlock), pools(&blocks) {}
+
+    LevelArena(const LevelArena&) = delete;
+    LevelArena& operator=(const LevelArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &pools; }
+
+    template <typename T, typename... Args>
+    ArenaPtr<T> make(Args&&... args) {
+        return makeIn<T>(&pools, std::forward<Args>(args)...);
+    }
+};
+
+class GameManager;
+
+// Abilities are data: what each one does is its effect kind plus the numbers below, and
+// EffectHandler<kind> carries it out. Anything an ability needs from the player, such as
+// which ability to use, an amount or a tile, is asked for by GameManager before it runs.
+enum class EffectKind : uint8_t {
+    DAMAGE,     // the target takes `damage`
+    HEAL,       // the user gains `heal`
+    RESTORE,    // the user goes back to full health
+    DRAIN,      // the target takes `damage` and the user gains `heal`
+    KILL,       // the target dies outright
+    END_GAME,
+    TELEPORT,   // the hero moves to the chosen tile
+};
+constexpr int EFFECT_KIND_COUNT = 7;
+
+enum class Targeting : uint8_t {
+    SELF,
+    ENEMY,
+    ENEMIES_IN_SIGHT,   // the enemy fought and every other enemy the hero can see
+    TILE,
+    WORLD,
+};
+
+enum AbilityId : uint8_t {
+    POWER_STRIKE, COSMIC_HEAL, UNIVERSE_RESET, TELEPORT,
+    EYES_OF_DEATH, EYES_OF_HEAL,
+    USE_SWORD, WALL_SHIELD,
+    MINI_ATTACK, MINI_HEAL,
+    LAST_ATTACK,
+    BONE_CRUSH,
+    DEATH_MAGIC, CURSE,
+    BURN_EVERYTHING, FIRE_SHIELD, BURN_MAP,
+    ABILITY_COUNT
+};
+
+struct AbilityDef {
+    AbilityId id;
+    // As listed in the ability menu.
+    const char* name;
+    EffectKind effect;
+    Targeting targeting;
+    int damage;
+    int heal;
+    // Healing may go past the maximum, which rises to match.
+    bool raisesMax;
+    // When set, the player picks the amount used for both `damage` and `heal`; the prompt
+    // offers 1 to `damage`.
+    const char* amountPrompt;
+    // Posted by the handler; the arguments each effect kind passes are listed with its handler.
+    const char* message;
+};
+
+inline constexpr AbilityDef ABILITIES[ABILITY_COUNT] = {
+    { POWER_STRIKE, "Power Strike", EffectKind::DAMAGE, Targeting::ENEMY, 500, 0, false, nullptr, "{} uses Power Strike on {} for {} damage.\n" },
+    { COSMIC_HEAL, "Cosmic Heal", EffectKind::HEAL, Targeting::SELF, 0, 100, true, nullptr, "{} uses Cosmic Heal. Health is now {}\n" },
+    { UNIVERSE_RESET, "Universe Reset", EffectKind::END_GAME, Targeting::WORLD, 0, 0, false, nullptr, "{} uses Universe Reset!\n" },
+    { TELEPORT, "Teleport", EffectKind::TELEPORT, Targeting::TILE, 0, 0, false, nullptr, "{} teleports to ({}, {}).\n" },
+    { EYES_OF_DEATH, "Eyes of Death", EffectKind::KILL, Targeting::ENEMIES_IN_SIGHT, 0, 0, false, nullptr, "{} is killed by Eyes of Death!\n" },
+    { EYES_OF_HEAL, "Eyes of Heal", EffectKind::DRAIN, Targeting::ENEMY, 100, 0, true, "Enter amount to heal: ", "{} steals {} health from {}\n" },
+    { USE_SWORD, "Use Sword", EffectKind::DAMAGE, Targeting::ENEMY, 35, 0, false, nullptr, "{} uses sword on {} for {} damage.\n" },
+    { WALL_SHIELD, "Wall Shield", EffectKind::RESTORE, Targeting::SELF, 0, 0, false, nullptr, "{} uses Wall Shield. Health is now {}\n" },
+    { MINI_ATTACK, "Mini Attack", EffectKind::DAMAGE, Targeting::ENEMY, 10, 0, false, nullptr, "{} uses Mini Attack on {} for {} damage.\n" },
+    { MINI_HEAL, "Mini Heal", EffectKind::DRAIN, Targeting::ENEMY, 10, 10, false, nullptr, "{} steals {} health from {}\n" },
+    { LAST_ATTACK, "Last Attack", EffectKind::DAMAGE, Targeting::ENEMY, 10, 0, false, nullptr, "{} uses Last Attack on {} for {} damage.\n" },
+    { BONE_CRUSH, "Bone Crush", EffectKind::DAMAGE, Targeting::ENEMY, 15, 0, false, nullptr, "{} uses Bone Crush on {} for {} damage.\n" },
+    { DEATH_MAGIC, "Death Magic", EffectKind::DAMAGE, Targeting::ENEMY, 20, 0, false, nullptr, "{} casts Death Magic!\n" },
+    { CURSE, "Curse", EffectKind::DAMAGE, Targeting::ENEMY, 10, 0, false, nullptr, "{} casts Curse!\n" },
+    { BURN_EVERYTHING, "Burn Everything", EffectKind::KILL, Targeting::ENEMY, 0, 0, false, nullptr, "{} is burned to death!\n" },
+    { FIRE_SHIELD, "Fire Shield", EffectKind::DRAIN, Targeting::ENEMY, 60, 30, false, nullptr, "{} uses Fire Shield, dealing {} damage to {} and healing for {}\n" },
+    { BURN_MAP, "Burn Map", EffectKind::END_GAME, Targeting::WORLD, 0, 0, false, nullptr, nullptr },
+};
+
+constexpr bool abilitiesInIdOrder() {
+    for (int i = 0; i < ABILITY_COUNT; ++i) {
+        if (ABILITIES[i].id != i) return false;
+    }
+    return true;
+}
+static_assert(abilitiesInIdOrder(), "ABILITIES must be indexed by AbilityId");
+
+// What one character can use, in menu order. Enemies pick one at random.
+struct AbilitySet {
+    // Printed above the menu; may be empty.
+    const char* heading;
+    const char* prompt;
+    int count;
+    AbilityId ids[4];
+};
+
+inline constexpr AbilitySet AETHER_ABILITIES = { "", "Enter command of Sphere of Everything: ", 4, { POWER_STRIKE, COSMIC_HEAL, UNIVERSE_RESET, TELEPORT } };
+inline constexpr AbilitySet SYNAX_ABILITIES = { "", "Activate red eyes: ", 2, { EYES_OF_DEATH, EYES_OF_HEAL } };
+inline constexpr AbilitySet KAHRAY_ABILITIES = { "Choose one of Kahray's abilities \n", "-> ", 2, { USE_SWORD, WALL_SHIELD } };
+inline constexpr AbilitySet YROY_ABILITIES = { "", "Choose your ability: ", 2, { MINI_ATTACK, MINI_HEAL } };
+inline constexpr AbilitySet BATLEY_ABILITIES = { "", "", 1, { LAST_ATTACK } };
+
+// Every character name, held once in static storage. Characters keep a NameId, so making one
+// copies no text and a name can be logged by reference.
+enum class NameId : uint8_t { AETHER, SYNAX, KAHRAY, YROY, BATLEY, SKELETON, WITCH, KHEON };
+
+// FNV-1a of the name: how the journal refers to a character.
+constexpr uint32_t journalIdOf(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) hash = (hash ^ uint8_t(c)) * 16777619u;
+    return hash;
+}
+
+struct NameInfo {
+    std::string_view text;
+    uint32_t journalId;
+};
+
+inline constexpr NameInfo NAMES[] = {
+    { "Aether", journalIdOf("Aether") },
+    { "Synax", journalIdOf("Synax") },
+    { "Kahray", journalIdOf("Kahray") },
+    { "Yroy", journalIdOf("Yroy") },
+    { "Batley", journalIdOf("Batley") },
+    { "Skeleton", journalIdOf("Skeleton") },
+    { "Witch", journalIdOf("Witch") },
+    { "Kheon", journalIdOf("Kheon") },
+};
+
+constexpr std::string_view nameOf(NameId id) {
+    return NAMES[static_cast<int>(id)].text;
+}
+
+class Character {
+private:
+    int ownHealth;
+    int ownMaxHealth;
+    NameId name;
+protected:
+    int& health;
+    int& maxHealth;
+    const AbilitySet* abilities;
+public:
+    Character(NameId nameId, int hp, int maxHp, const AbilitySet& set)
+        : ownHealth(hp), ownMaxHealth(maxHp), name(nameId), health(ownHealth), maxHealth(ownMaxHealth), abilities(&set) {};
+
+    // A view over health kept somewhere else, such as an EnemyStore slot.
+    Character(NameId nameId, int* hp, int* maxHp, const AbilitySet& set)
+        : ownHealth(0), ownMaxHealth(0), name(nameId), health(*hp), maxHealth(*maxHp), abilities(&set) {};
+
+    Character(const Character&) = delete;
+    Character& operator=(const Character&) = delete;
+
+    virtual ~Character() {};
+
+    void takeDamage(int damage) {
+        health -= damage;
+        if (health <= 0) health = 0;
+        if (EventJournal* journal = EventJournal::current()) journal->damage(NAMES[static_cast<int>(name)].journalId, damage, health);
+        logMessage<MessageLog::EVENT>("{} takes {} damage. Health is now {}\n", getName(), damage, health);
+    }
+
+    void heal(int amount) {
+        health += amount;
+        if (health > maxHealth) health = maxHealth;
+        if (EventJournal* journal = EventJournal::current()) journal->heal(NAMES[static_cast<int>(name)].journalId, amount, health);
+        logMessage<MessageLog::EVENT>("{} heals {} health. Health is now {}\n", getName(), amount, health);
+    }
+
+    bool isAlive() const {
+        return health > 0;
+    }
+
+    void setHealth() {
+        health = 0;
+    }
+
+    std::string_view getName() const {
+        return nameOf(name);
+    }
+
+    NameId getNameId() const {
+        return name;
+    }
+
+    int getHealth() const {
+        return health;
+    }
+
+    int getMaxHealth() const {
+        return maxHealth;
+    }
+
+    void restoreHealth(int hp, int maxHp) {
+        health = hp;
+        maxHealth = maxHp;
+    }
+
+    const AbilitySet& getAbilities() const {
+        return *abilities;
+    }
+
+    virtual void displayInfo() const = 0;
+};
+
+// One use of an ability, with everything the player chose already filled in.
+struct AbilityUse {
+    AbilityId ability = POWER_STRIKE;
+    Character* user = nullptr;
+    Character* target = nullptr;
+    // The amount picked for abilities with an amountPrompt.
+    int amount = 0;
+    // The tile picked for TILE targeting.
+    int x = 0;
+    int y = 0;
+};
+
+// Health as plain numbers, for fights played out in a lookahead search.
+struct Vitals {
+    int health;
+    int maxHealth;
+};
+
+// No handler reads input or makes a virtual call. `game` may be null, for abilities used
+// outside a game; effects on the map or the game then do nothing. simulate() has the same
+// effect on bare Vitals, silently; `ended` is set if the game would end.
+template <EffectKind K>
+struct EffectHandler;
+
+// Message arguments: user, target, damage.
+template <>
+struct EffectHandler<EffectKind::DAMAGE> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager*) {
+        logMessage<MessageLog::EVENT>(def.message, use.user->getName(), use.target->getName(), def.damage);
+        use.target->takeDamage(def.damage);
+    }
+
+    static void simulate(const AbilityDef& def, Vitals&, Vitals& target, int, bool&) {
+        target.health = std::max(target.health - def.damage, 0);
+    }
+};
+
+inline void gainHealth(Vitals& user, int amount, bool raisesMax) {
+    int health = user.health + amount;
+    user.maxHealth = raisesMax ? std::max(health, user.maxHealth) : user.maxHealth;
+    user.health = std::min(health, user.maxHealth);
+}
+
+// Adds `amount` to the user's health without going through heal(), so it isn't journaled.
+inline void gainHealth(Character& user, int amount, bool raisesMax) {
+    Vitals vitals{ user.getHealth(), user.getMaxHealth() };
+    gainHealth(vitals, amount, raisesMax);
+    user.restoreHealth(vitals.health, vitals.maxHealth);
+}
+
+// Message arguments: user, health after.
+template <>
+struct EffectHandler<EffectKind::HEAL> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager*) {
+        gainHealth(*use.user, def.heal, def.raisesMax);
+        logMessage<MessageLog::EVENT>(def.message, use.user->getName(), use.user->getHealth());
+    }
+
+    static void simulate(const AbilityDef& def, Vitals& user, Vitals&, int, bool&) {
+        gainHealth(user, def.heal, def.raisesMax);
+    }
+};
+
+// Message arguments: user, health after.
+template <>
+struct EffectHandler<EffectKind::RESTORE> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager*) {
+        use.user->restoreHealth(use.user->getMaxHealth(), use.user->getMaxHealth());
+        logMessage<MessageLog::EVENT>(def.message, use.user->getName(), use.user->getHealth());
+    }
+
+    static void simulate(const AbilityDef&, Vitals& user, Vitals&, int, bool&) {
+        user.health = user.maxHealth;
+    }
+};
+
+// Message arguments: user, damage, target, health gained.
+template <>
+struct EffectHandler<EffectKind::DRAIN> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager*) {
+        int damage = def.amountPrompt ? use.amount : def.damage;
+        int gained = def.amountPrompt ? use.amount : def.heal;
+        use.target->takeDamage(damage);
+        gainHealth(*use.user, gained, def.raisesMax);
+        logMessage<MessageLog::EVENT>(def.message, use.user->getName(), damage, use.target->getName(), gained);
+    }
+
+    static void simulate(const AbilityDef& def, Vitals& user, Vitals& target, int amount, bool&) {
+        target.health = std::max(target.health - (def.amountPrompt ? amount : def.damage), 0);
+        gainHealth(user, def.amountPrompt ? amount : def.heal, def.raisesMax);
+    }
+};
+
+// Message arguments: target. With ENEMIES_IN_SIGHT, also kills every other enemy the hero sees.
+template <>
+struct EffectHandler<EffectKind::KILL> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager* game);
+
+    // Other enemies in sight are not part of the fight.
+    static void simulate(const AbilityDef&, Vitals&, Vitals& target, int, bool&) {
+        target.health = 0;
+    }
+};
+
+// Message arguments: user.
+template <>
+struct EffectHandler<EffectKind::END_GAME> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager* game);
+
+    static void simulate(const AbilityDef&, Vitals&, Vitals&, int, bool& ended) {
+        ended = true;
+    }
+};
+
+// Message arguments: user, x, y.
+template <>
+struct EffectHandler<EffectKind::TELEPORT> {
+    static void apply(const AbilityDef& def, const AbilityUse& use, GameManager* game);
+
+    // The fight goes on wherever the hero lands.
+    static void simulate(const AbilityDef&, Vitals&, Vitals&, int, bool&) {}
+};
+
+template <size_t... K>
+constexpr auto makeEffectTable(std::index_sequence<K...>) {
+    using Handler = void (*)(const AbilityDef&, const AbilityUse&, GameManager*);
+    return std::array<Handler, sizeof...(K)>{ &EffectHandler<static_cast<EffectKind>(K)>::apply... };
+}
+
+template <size_t... K>
+constexpr auto makeSimulationTable(std::index_sequence<K...>) {
+    using Simulator = void (*)(const AbilityDef&, Vitals&, Vitals&, int, bool&);
+    return std::array<Simulator, sizeof...(K)>{ &EffectHandler<static_cast<EffectKind>(K)>::simulate... };
+}
+
+// Runs an ability through its effect kind's handler, found in a table built at compile time.
+inline void applyAbility(const AbilityUse& use, GameManager* game = nullptr) {
+    static constexpr auto handlers = makeEffectTable(std::make_index_sequence<EFFECT_KIND_COUNT>());
+    const AbilityDef& def = ABILITIES[use.ability];
+    handlers[static_cast<int>(def.effect)](def, use, game);
+}
+
+inline void simulateAbility(AbilityId ability, Vitals& user, Vitals& target, int amount, bool& ended) {
+    static constexpr auto simulators = makeSimulationTable(std::make_index_sequence<EFFECT_KIND_COUNT>());
+    const AbilityDef& def = ABILITIES[ability];
+    simulators[static_cast<int>(def.effect)](def, user, target, amount, ended);
+}
+
+// Everything the rules of a fight read and change, as plain values. Copying it is a snapshot
+// and assigning the copy back is an undo, so a search can play a turn out and take it back in
+// a few nanoseconds. The map, the other enemies and the journal play no part in a fight and
+// are left out.
+struct CombatState {
+    Vitals hero;
+    Vitals enemy;
+    bool ended = false;
+};
+
+// Picks an enemy's ability by expectimax over the fight: the enemy takes its best ability,
+// and the hero is assumed to pick uniformly among attacking, healing and each of its own
+// abilities, as the balance simulator does. Searches one enemy turn deeper at a time while the
+// next depth is expected to fit in the turn budget, and keeps the choice from the deepest
+// search that finished.
+class CombatLookahead {
+public:
+    static constexpr int MAX_DEPTH = 16;
+
+private:
+    // The hero's options: attack, heal, then its abilities, with the largest amount where one
+    // is asked for.
+    struct HeroMove { int action; AbilityId ability; int amount; };
+    HeroMove heroMoves[6];
+    int heroMoveCount = 0;
+    const AbilitySet& enemySet;
+    uint64_t turns = 0;
+    int depthReached = 0;
+    // Set when some line was still going at the search horizon.
+    bool cutOff = false;
+
+    // From the enemy's side: 1 if the hero dies, -1 if the enemy does, 0 if the game ends.
+    // Otherwise the difference in remaining health fractions, kept inside (-0.5, 0.5) so an
+    // outcome always beats a guess.
+    static double score(const CombatState& state) {
+        if (state.hero.health <= 0) return 1;
+        if (state.enemy.health <= 0) return -1;
+        if (state.ended) return 0;
+        double enemy = double(state.enemy.health) / std::max(state.enemy.maxHealth, 1);
+        double hero = double(state.hero.health) / std::max(state.hero.maxHealth, 1);
+        return 0.25 * (std::min(enemy, 1.0) - std::min(hero, 1.0));
+    }
+
+    static bool over(const CombatState& state) {
+        return state.hero.health <= 0 || state.enemy.health <= 0 || state.ended;
+    }
+
+    CombatState afterEnemy(CombatState state, AbilityId ability) {
+        ++turns;
+        simulateAbility(ability, state.enemy, state.hero, 0, state.ended);
+        return state;
+    }
+
+    CombatState afterHero(CombatState state, const HeroMove& move) {
+        ++turns;
+        if (move.action == 1) state.enemy.health = std::max(state.enemy.health - 20, 0);
+        else if (move.action == 3) gainHealth(state.hero, 15, false);
+        else simulateAbility(move.ability, state.hero, state.enemy, move.amount, state.ended);
+        return state;
+    }
+
+    // The enemy is to move; `depth` more enemy turns are searched after this one.
+    double enemyTurn(const CombatState& state, int depth, int* best) {
+        double bestValue = -2;
+        for (int i = 0; i < enemySet.count; ++i) {
+            CombatState next = afterEnemy(state, enemySet.ids[i]);
+            bool done = over(next);
+            if (!done && depth == 0) cutOff = true;
+            double value = done || depth == 0 ? score(next) : heroTurn(next, depth);
+            if (value > bestValue) {
+                bestValue = value;
+                if (best) *best = i;
+            }
+        }
+        return bestValue;
+    }
+
+    double heroTurn(const CombatState& state, int depth) {
+        double total = 0;
+        for (int i = 0; i < heroMoveCount; ++i) {
+            CombatState next = afterHero(state, heroMoves[i]);
+            total += over(next) ? score(next) : enemyTurn(next, depth - 1, nullptr);
+        }
+        return total / heroMoveCount;
+    }
+
+public:
+    CombatLookahead(const AbilitySet& heroSet, const AbilitySet& enemyAbilities) : enemySet(enemyAbilities) {
+        heroMoves[heroMoveCount++] = HeroMove{ 1, POWER_STRIKE, 0 };
+        heroMoves[heroMoveCount++] = HeroMove{ 3, POWER_STRIKE, 0 };
+        for (int i = 0; i < heroSet.count; ++i) {
+            const AbilityDef& def = ABILITIES[heroSet.ids[i]];
+            heroMoves[heroMoveCount++] = HeroMove{ 2, def.id, def.amountPrompt ? def.damage : 0 };
+        }
+    }
+
+    // Index into the enemy's AbilitySet of the ability to use, spending at most about
+    // `turnBudget` simulated turns.
+    int choose(const CombatState& state, uint64_t turnBudget) {
+        turns = 0;
+        depthReached = 0;
+        int choice = 0;
+        // Each extra enemy turn multiplies the tree by at most `growth`; once two depths have
+        // run, by about as much as the last one did.
+        double growth = double(enemySet.count) * double(heroMoveCount);
+        uint64_t last = 0;
+        for (int depth = 0; depth < MAX_DEPTH; ++depth) {
+            if (depth > 0 && double(turns) + double(last) * growth > double(turnBudget)) break;
+            uint64_t before = turns;
+            int best = 0;
+            cutOff = false;
+            double value = enemyTurn(state, depth, &best);
+            choice = best;
+            depthReached = depth + 1;
+            if (depth > 0) growth = double(turns - before) / double(std::max<uint64_t>(last, 1));
+            last = turns - before;
+            // A sure win cannot be improved on, and if every line of the fight ended inside
+            // the horizon, looking deeper changes nothing.
+            if (value >= 1 || !cutOff) break;
+        }
+        return choice;
+    }
+
+    uint64_t lastTurns() const { return turns; }
+    int lastDepth() const { return depthReached; }
+};
+
+enum class TileType : uint8_t {
+    EMPTY = 0,
+    WALL,
+    HERO,
+    ENEMY
+};
+
+// The set of Map words that still hold at least one EMPTY tile, with O(1) add, remove and
+// uniform pick. Map keeps it current from every write when it is enabled.
+class FreeCellIndex {
+private:
+    static constexpr uint32_t ABSENT = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> words;
+    std::vector<uint32_t> position;
+
+public:
+    explicit FreeCellIndex(size_t wordCount) : position(wordCount, ABSENT) {}
+
+    void set(size_t word, bool hasFree) {
+        uint32_t& pos = position[word];
+        if (hasFree && pos == ABSENT) {
+            pos = uint32_t(words.size());
+            words.push_back(uint32_t(word));
+        } else if (!hasFree && pos != ABSENT) {
+            uint32_t last = words.back();
+            words[pos] = last;
+            position[last] = pos;
+            words.pop_back();
+            pos = ABSENT;
+        }
+    }
+
+    size_t size() const { return words.size(); }
+    uint32_t pick(Rng& rng) const { return words[rng.below(uint32_t(words.size()))]; }
+};
+
+// A file's contents in memory. On POSIX systems it is mapped copy-on-write, so opening is
+// O(1) and pages are read on first touch; writes go to private copies and never reach the file.
+class MappedFile {
+private:
+    char* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (base) munmap(base, length);
+#endif
+    }
+
+    static std::unique_ptr<MappedFile> open(const std::string& path) {
+        auto file = std::make_unique<MappedFile>();
+#ifdef _WIN32
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return nullptr;
+        file->buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        file->base = file->buffer.data();
+        file->length = file->buffer.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat info;
+        if (fstat(fd, &info) < 0 || info.st_size == 0) {
+            close(fd);
+            return nullptr;
+        }
+        void* mapped = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) return nullptr;
+        file->base = static_cast<char*>(mapped);
+        file->length = size_t(info.st_size);
+#endif
+        return file;
+    }
+
+    char* data() { return base; }
+    size_t size() const { return length; }
+};
+
+// Tiles are packed 2 bits each, 32 per 64-bit word, in one row-major buffer.
+// Every row starts on a word boundary so rows can be processed a word at a time. The buffer is
+// either owned or borrowed from a mapped snapshot; writes mark 4 KiB chunks dirty so a save
+// can rewrite only what changed.
+class Map {
+public:
+    // How many single-tile wall changes are remembered for incremental consumers.
+    static constexpr uint64_t WALL_LOG_SIZE = 64;
+    static constexpr int BITS_PER_TILE = 2;
+    static constexpr int TILES_PER_WORD = 64 / BITS_PER_TILE;
+    static constexpr uint64_t TILE_MASK = (uint64_t(1) << BITS_PER_TILE) - 1;
+    static constexpr uint64_t LANE_LOW_BITS = 0x5555555555555555ULL;
+    static constexpr size_t CHUNK_WORDS = 512;
+    // Sides a map can be asked for: a border plus room to move, up to 256 MiB of tiles.
+    static constexpr int MIN_SIDE = 5;
+    static constexpr int MAX_SIDE = 32768;
+
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    uint64_t lastWordMask;
+    std::vector<uint64_t> ownedCells;
+    std::unique_ptr<MappedFile> mappedCells;
+    uint64_t* cells;
+    size_t cellCount;
+    std::vector<uint64_t> dirtyChunks;
+    size_t tileCounts[4];
+    std::unique_ptr<FreeCellIndex> freeCells;
+    uint64_t wallVersion = 0;
+    std::pair<int, int> wallLog[WALL_LOG_SIZE];
+    // Tiles changed since the last takeTilesWritten(), for the profiler.
+    uint64_t tilesWritten = 0;
+
+    void markDirty(size_t index) {
+        size_t chunk = index / CHUNK_WORDS;
+        dirtyChunks[chunk / 64] |= uint64_t(1) << (chunk % 64);
+    }
+
+    size_t wordIndex(int x, int y) const {
+        return size_t(y) * wordsPerRow + (x / TILES_PER_WORD);
+    }
+
+    static int laneShift(int x) {
+        return (x % TILES_PER_WORD) * BITS_PER_TILE;
+    }
+
+    // Mask covering the lanes of tiles [x0, x1) that fall inside word `w` of a row.
+    static uint64_t spanMask(int w, int x0, int x1) {
+        int lo = std::max(x0 - w * TILES_PER_WORD, 0);
+        int hi = std::min(x1 - w * TILES_PER_WORD, TILES_PER_WORD);
+        if (lo >= hi) return 0;
+        uint64_t upper = hi == TILES_PER_WORD ? ~uint64_t(0) : (uint64_t(1) << (hi * BITS_PER_TILE)) - 1;
+        uint64_t lower = (uint64_t(1) << (lo * BITS_PER_TILE)) - 1;
+        return upper & ~lower;
+    }
+
+public:
+    Map(int w, int h)
+        : width(w), height(h),
+          wordsPerRow((w + TILES_PER_WORD - 1) / TILES_PER_WORD),
+          lastWordMask(spanMask(0, 0, w % TILES_PER_WORD == 0 ? TILES_PER_WORD : w % TILES_PER_WORD)),
+          ownedCells(size_t(wordsPerRow) * h, 0), cells(ownedCells.data()), cellCount(ownedCells.size()),
+          dirtyChunks((chunkCount() + 63) / 64, 0), tileCounts{size_t(w) * h, 0, 0, 0} {
+        fillRow(0, 0, width, TileType::WALL);
+        fillRow(height - 1, 0, width, TileType::WALL);
+        for (int i = 0; i < height; ++i) {
+            setTileUnchecked(0, i, TileType::WALL);
+            setTileUnchecked(width - 1, i, TileType::WALL);
+        }
+    }
+
+    // Uses `words` tile words at `offset` in a mapped snapshot as the tile buffer, without
+    // copying; `counts` are the per-type tile counts saved with it. Nothing starts dirty.
+    Map(int w, int h, std::unique_ptr<MappedFile> file, size_t offset, const uint64_t counts[4])
+        : width(w), height(h),
+          wordsPerRow((w + TILES_PER_WORD - 1) / TILES_PER_WORD),
+          lastWordMask(spanMask(0, 0, w % TILES_PER_WORD == 0 ? TILES_PER_WORD : w % TILES_PER_WORD)),
+          mappedCells(std::move(file)), cells(reinterpret_cast<uint64_t*>(mappedCells->data() + offset)),
+          cellCount(size_t(wordsPerRow) * h), dirtyChunks((chunkCount() + 63) / 64, 0),
+          tileCounts{size_t(counts[0]), size_t(counts[1]), size_t(counts[2]), size_t(counts[3])} {}
+
+    void display(std::ostream& out = std::cout) const {
+        static const char* glyphs[] = { ". ", "# ", "H ", "E " };
+        std::string line;
+        line.reserve(size_t(width) * 2 + 1);
+        for (int y = 0; y < height; ++y) {
+            line.clear();
+            for (int x = 0; x < width; ++x) {
+                line += glyphs[static_cast<int>(getTileUnchecked(x, y))];
+            }
+            line += '\n';
+            out << line;
+        }
+        out.flush();
+    }
+
+    void setTile(int x, int y, TileType type) {
+        if (y >= 0 && y < height && x >= 0 && x < width) {
+            setTileUnchecked(x, y, type);
+        }
+    }
+
+    TileType getTile(int x, int y) const {
+        if (y >= 0 && y < height && x >= 0 && x < width) {
+            return getTileUnchecked(x, y);
+        }
+        return TileType::WALL;
+    }
+
+    // No bounds checks: callers must pass 0 <= x < width and 0 <= y < height.
+    TileType getTileUnchecked(int x, int y) const {
+        return static_cast<TileType>((cells[wordIndex(x, y)] >> laneShift(x)) & TILE_MASK);
+    }
+
+    void setTileUnchecked(int x, int y, TileType type) {
+        size_t index = wordIndex(x, y);
+        uint64_t& word = cells[index];
+        int shift = laneShift(x);
+        TileType old = static_cast<TileType>((word >> shift) & TILE_MASK);
+        if (old == type) return;
+        --tileCounts[static_cast<int>(old)];
+        ++tileCounts[static_cast<int>(type)];
+        word = (word & ~(TILE_MASK << shift)) | (uint64_t(type) << shift);
+        markDirty(index);
+#if ANKR_PROFILE
+        ++tilesWritten;
+#endif
+        if (old == TileType::WALL || type == TileType::WALL) {
+            wallLog[wallVersion % WALL_LOG_SIZE] = std::make_pair(x, y);
+            ++wallVersion;
+        }
+        if (freeCells && (old == TileType::EMPTY || type == TileType::EMPTY)) {
+            freeCells->set(index, freeLanes(index) != 0);
+        }
+    }
+
+    // For passes where each thread owns whole tile words: changes only the tile and its
+    // chunk's dirty bit, which may be shared. Counts and the free-cell index are not touched,
+    // so a pass must take off exactly the ENEMY and EMPTY tiles it puts down, with the index
+    // dropped first.
+    void setTileShared(int x, int y, TileType type) {
+        size_t index = wordIndex(x, y);
+        int shift = laneShift(x);
+        cells[index] = (cells[index] & ~(TILE_MASK << shift)) | (uint64_t(type) << shift);
+        size_t chunk = index / CHUNK_WORDS;
+        uint64_t bit = uint64_t(1) << (chunk % 64);
+        if (!(__atomic_load_n(&dirtyChunks[chunk / 64], __ATOMIC_RELAXED) & bit)) {
+            __atomic_fetch_or(&dirtyChunks[chunk / 64], bit, __ATOMIC_RELAXED);
+        }
+    }
+
+    // A word with every lane set to `type`.
+    static uint64_t broadcast(TileType type) {
+        return LANE_LOW_BITS * uint64_t(type);
+    }
+
+    // Low bit of each lane is set where the tile in `word` equals `type`.
+    static uint64_t matchLanes(uint64_t word, TileType type) {
+        uint64_t diff = word ^ broadcast(type);
+        return ~(diff | (diff >> 1)) & LANE_LOW_BITS;
+    }
+
+    // Sets tiles [x0, x1) of row y, a whole word at a time where possible.
+    void fillRow(int y, int x0, int x1, TileType type) {
+        if (y < 0 || y >= height) return;
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width);
+        if (x0 >= x1) return;
+        uint64_t pattern = broadcast(type);
+        size_t rowStart = size_t(y) * wordsPerRow;
+        uint64_t* row = &cells[rowStart];
+        for (int w = x0 / TILES_PER_WORD; w <= (x1 - 1) / TILES_PER_WORD; ++w) {
+            uint64_t mask = spanMask(w, x0, x1);
+            uint64_t lanes = mask & LANE_LOW_BITS;
+            int wallsBefore = __builtin_popcountll(matchLanes(row[w], TileType::WALL) & lanes);
+            if (type == TileType::WALL ? wallsBefore != __builtin_popcountll(lanes) : wallsBefore != 0) {
+                // Too many cells to log one by one; push incremental consumers into a full rebuild.
+                wallVersion += WALL_LOG_SIZE + 1;
+            }
+            for (int t = 0; t < 4; ++t) {
+                tileCounts[t] -= __builtin_popcountll(matchLanes(row[w], static_cast<TileType>(t)) & lanes);
+            }
+            tileCounts[static_cast<int>(type)] += __builtin_popcountll(lanes);
+            row[w] = (row[w] & ~mask) | (pattern & mask);
+            markDirty(rowStart + w);
+            if (freeCells) freeCells->set(rowStart + w, freeLanes(rowStart + w) != 0);
+        }
+    }
+
+    void fillRect(int x0, int y0, int x1, int y1, TileType type) {
+        for (int y = std::max(y0, 0); y < std::min(y1, height); ++y) {
+            fillRow(y, x0, x1, type);
+        }
+    }
+
+    int countInRow(int y, TileType type) const {
+        const uint64_t* row = rowWords(y);
+        int count = 0;
+        for (int w = 0; w < wordsPerRow; ++w) {
+            uint64_t lanes = matchLanes(row[w], type);
+            if (w == wordsPerRow - 1) lanes &= lastWordMask;
+            count += __builtin_popcountll(lanes);
+        }
+        return count;
+    }
+
+    size_t countTiles(TileType type) const {
+        size_t count = 0;
+        for (int y = 0; y < height; ++y) {
+            count += countInRow(y, type);
+        }
+        return count;
+    }
+
+    // For a map built over words from a file: whether the lanes past each row's last tile are
+    // clear and the tiles agree with the counts it was given. One pass over the words.
+    bool tilesConsistent() const {
+        size_t counts[4] = {};
+        for (int y = 0; y < height; ++y) {
+            const uint64_t* row = rowWords(y);
+            if (row[wordsPerRow - 1] & ~lastWordMask) return false;
+            for (int w = 0; w < wordsPerRow; ++w) {
+                uint64_t low = row[w] & LANE_LOW_BITS, high = row[w] >> 1 & LANE_LOW_BITS;
+                counts[static_cast<int>(TileType::WALL)] += size_t(__builtin_popcountll(low & ~high));
+                counts[static_cast<int>(TileType::HERO)] += size_t(__builtin_popcountll(high & ~low));
+                counts[static_cast<int>(TileType::ENEMY)] += size_t(__builtin_popcountll(low & high));
+            }
+        }
+        counts[static_cast<int>(TileType::EMPTY)] = size_t(width) * height - counts[1] - counts[2] - counts[3];
+        return std::equal(counts, counts + 4, tileCounts);
+    }
+
+    // Bit i is set where tile (x0 + i, y) is `type`, for 64 tiles starting at x0. Tiles off the
+    // map count as WALL, as in getTile.
+    uint64_t tileBits(int x0, int y, TileType type) const {
+        int firstWord = (x0 >= 0 ? x0 : x0 - TILES_PER_WORD + 1) / TILES_PER_WORD;
+        int offset = x0 - firstWord * TILES_PER_WORD;
+        uint64_t chunks[3];
+        for (int i = 0; i < 3; ++i) {
+            int w = firstWord + i;
+            uint64_t lanes;
+            if (y < 0 || y >= height || w < 0 || w >= wordsPerRow) {
+                lanes = type == TileType::WALL ? LANE_LOW_BITS : 0;
+            } else {
+                const uint64_t word = cells[size_t(y) * wordsPerRow + w];
+                lanes = matchLanes(word, type);
+                if (w == wordsPerRow - 1) {
+                    lanes &= lastWordMask;
+                    if (type == TileType::WALL) lanes |= ~lastWordMask & LANE_LOW_BITS;
+                }
+            }
+            // Gather the low bit of each 2-bit lane into the low 32 bits.
+            lanes = (lanes | (lanes >> 1)) & 0x3333333333333333ULL;
+            lanes = (lanes | (lanes >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+            lanes = (lanes | (lanes >> 4)) & 0x00FF00FF00FF00FFULL;
+            lanes = (lanes | (lanes >> 8)) & 0x0000FFFF0000FFFFULL;
+            chunks[i] = (lanes | (lanes >> 16)) & 0xFFFFFFFFULL;
+        }
+        uint64_t bits = (chunks[0] >> offset) | (chunks[1] << (TILES_PER_WORD - offset));
+        if (offset) bits |= chunks[2] << (2 * TILES_PER_WORD - offset);
+        return bits;
+    }
+
+    uint64_t getWord(int wordX, int y) const { return cells[size_t(y) * wordsPerRow + wordX]; }
+
+    // Replaces 32 tiles at once, for bulk loads such as streaming in world chunks.
+    void setWord(int wordX, int y, uint64_t value) {
+        size_t index = size_t(y) * wordsPerRow + wordX;
+        uint64_t mask = wordX == wordsPerRow - 1 ? lastWordMask : ~uint64_t(0);
+        uint64_t lanes = mask & LANE_LOW_BITS;
+        uint64_t old = cells[index];
+        value &= mask;
+        if (old == value) return;
+        for (int t = 0; t < 4; ++t) {
+            tileCounts[t] -= __builtin_popcountll(matchLanes(old, static_cast<TileType>(t)) & lanes);
+            tileCounts[t] += __builtin_popcountll(matchLanes(value, static_cast<TileType>(t)) & lanes);
+        }
+        if ((matchLanes(old, TileType::WALL) ^ matchLanes(value, TileType::WALL)) & lanes) wallVersion += WALL_LOG_SIZE + 1;
+#if ANKR_PROFILE
+        uint64_t changed = old ^ value;
+        tilesWritten += __builtin_popcountll((changed | (changed >> 1)) & lanes);
+#endif
+        cells[index] = value;
+        markDirty(index);
+        if (freeCells) freeCells->set(index, freeLanes(index) != 0);
+    }
+
+    // Bumped whenever a tile becomes or stops being a WALL.
+    uint64_t getWallVersion() const { return wallVersion; }
+
+    uint64_t takeTilesWritten() {
+        uint64_t written = tilesWritten;
+        tilesWritten = 0;
+        return written;
+    }
+
+    // The cell whose change moved the wall version from `version` to `version + 1`, if it is
+    // still in the log.
+    bool wallChangeAt(uint64_t version, int& x, int& y) const {
+        if (version >= wallVersion || wallVersion - version > WALL_LOG_SIZE) return false;
+        x = wallLog[version % WALL_LOG_SIZE].first;
+        y = wallLog[version % WALL_LOG_SIZE].second;
+        return true;
+    }
+
+    // Exact number of tiles of each type, kept up to date by every write.
+    size_t countOf(TileType type) const { return tileCounts[static_cast<int>(type)]; }
+
+    // Low lane bits set for the EMPTY tiles of word `index`, ignoring the padding past the row end.
+    uint64_t freeLanes(size_t index) const {
+        uint64_t lanes = matchLanes(cells[index], TileType::EMPTY);
+        if (index % wordsPerRow == size_t(wordsPerRow - 1)) lanes &= lastWordMask;
+        return lanes;
+    }
+
+    // Costs 8 bytes per word (a quarter byte per tile) and makes sampleEmptyCell O(1).
+    void enableFreeCellIndex() {
+        if (freeCells) return;
+        freeCells = std::make_unique<FreeCellIndex>(cellCount);
+        for (size_t i = 0; i < cellCount; ++i) {
+            if (freeLanes(i)) freeCells->set(i, true);
+        }
+    }
+
+    void disableFreeCellIndex() {
+        freeCells.reset();
+    }
+
+    // Picks an EMPTY tile uniformly at random. Draws a word that still has room and a lane
+    // inside it, and retries if that lane is taken: every free tile is equally likely per
+    // draw and a draw succeeds with probability at least 1/32. Returns false when the map is
+    // full. Falls back to rejection over the whole map without the index.
+    bool sampleEmptyCell(Rng& rng, int& x, int& y) const {
+        if (countOf(TileType::EMPTY) == 0) return false;
+        for (;;) {
+            size_t index;
+            uint32_t lane = rng.below(TILES_PER_WORD);
+            if (freeCells) {
+                index = freeCells->pick(rng);
+            } else {
+                index = rng.below(uint32_t(cellCount));
+            }
+            if (!((freeLanes(index) >> (lane * BITS_PER_TILE)) & 1)) continue;
+            y = int(index / wordsPerRow);
+            x = int(index % wordsPerRow) * TILES_PER_WORD + int(lane);
+            return true;
+        }
+    }
+
+    const uint64_t* rowWords(int y) const { return &cells[size_t(y) * wordsPerRow]; }
+    int getWordsPerRow() const { return wordsPerRow; }
+    size_t memoryBytes() const { return cellCount * sizeof(uint64_t); }
+
+    // The whole tile buffer, for snapshots.
+    const uint64_t* words() const { return cells; }
+    size_t wordCount() const { return cellCount; }
+
+    size_t chunkCount() const { return (cellCount + CHUNK_WORDS - 1) / CHUNK_WORDS; }
+    bool chunkDirty(size_t chunk) const { return (dirtyChunks[chunk / 64] >> (chunk % 64)) & 1; }
+    void markAllDirty() { for (size_t c = 0; c < chunkCount(); ++c) dirtyChunks[c / 64] |= uint64_t(1) << (c % 64); }
+    void clearDirty() { std::fill(dirtyChunks.begin(), dirtyChunks.end(), 0); }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
+
+// Maps a cell to the value living on it. Values are kept densely in insertion order (erase
+// swaps the last one into the hole) and an open-addressing table maps packed cell keys to
+// their position, so lookup, insert, erase and move are O(1). Pointers returned by find()
+// stay valid only until the next insert or erase.
+template <typename T>
+class SpatialIndex {
+public:
+    struct Entry {
+        int x;
+        int y;
+        T value;
+    };
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+    std::pmr::vector<Entry> entries;
+    std::pmr::vector<uint32_t> slots;
+    size_t slotMask = 0;
+    int slotShift = 64;
+
+    static uint64_t key(int x, int y) {
+        return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+    }
+
+    // Fibonacci hashing: the top bits of the product mix in every bit of both coordinates.
+    size_t home(uint64_t k) const {
+        return size_t((k * 0x9E3779B97F4A7C15ULL) >> slotShift);
+    }
+
+    size_t findSlot(int x, int y) const {
+        if (slots.empty()) return size_t(-1);
+        uint64_t k = key(x, y);
+        for (size_t s = home(k);; s = (s + 1) & slotMask) {
+            uint32_t idx = slots[s];
+            if (idx == EMPTY_SLOT) return size_t(-1);
+            if (entries[idx].x == x && entries[idx].y == y) return s;
+        }
+    }
+
+    void placeSlot(uint32_t idx) {
+        for (size_t s = home(key(entries[idx].x, entries[idx].y));; s = (s + 1) & slotMask) {
+            if (slots[s] == EMPTY_SLOT) {
+                slots[s] = idx;
+                return;
+            }
+        }
+    }
+
+    // Linear probing with backward-shift deletion, so the table never accumulates tombstones.
+    void clearSlot(size_t hole) {
+        size_t s = hole;
+        for (;;) {
+            s = (s + 1) & slotMask;
+            uint32_t idx = slots[s];
+            if (idx == EMPTY_SLOT) break;
+            size_t h = home(key(entries[idx].x, entries[idx].y));
+            bool movable = hole <= s ? (h <= hole || h > s) : (h <= hole && h > s);
+            if (movable) {
+                slots[hole] = idx;
+                hole = s;
+            }
+        }
+        slots[hole] = EMPTY_SLOT;
+    }
+
+    size_t slotOfIndex(uint32_t idx) const {
+        return findSlot(entries[idx].x, entries[idx].y);
+    }
+
+    void rehash(size_t capacity) {
+        slots.assign(capacity, EMPTY_SLOT);
+        slotMask = capacity - 1;
+        slotShift = 64 - __builtin_ctzll(capacity);
+        for (uint32_t i = 0; i < entries.size(); ++i) placeSlot(i);
+    }
+
+public:
+    explicit SpatialIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : entries(resource), slots(resource) {}
+
+    void reserve(size_t count) {
+        entries.reserve(count);
+        size_t capacity = 16;
+        while (capacity < count * 2) capacity *= 2;
+        if (capacity > slots.size()) rehash(capacity);
+    }
+
+    T* find(int x, int y) {
+        size_t s = findSlot(x, y);
+        return s == size_t(-1) ? nullptr : &entries[slots[s]].value;
+    }
+
+    const T* find(int x, int y) const {
+        size_t s = findSlot(x, y);
+        return s == size_t(-1) ? nullptr : &entries[slots[s]].value;
+    }
+
+    bool contains(int x, int y) const {
+        return findSlot(x, y) != size_t(-1);
+    }
+
+    // Returns false and leaves the index untouched if the cell is already occupied.
+    bool insert(int x, int y, T value) {
+        if (contains(x, y)) return false;
+        insertUnique(x, y, std::move(value));
+        return true;
+    }
+
+    // For callers that already know the cell is free, e.g. because its tile is EMPTY.
+    void insertUnique(int x, int y, T value) {
+        if ((entries.size() + 1) * 2 > slots.size()) rehash(std::max<size_t>(16, slots.size() * 2));
+        entries.push_back(Entry{x, y, std::move(value)});
+        placeSlot(uint32_t(entries.size() - 1));
+    }
+
+    bool erase(int x, int y) {
+        size_t s = findSlot(x, y);
+        if (s == size_t(-1)) return false;
+        uint32_t idx = slots[s];
+        clearSlot(s);
+        uint32_t last = uint32_t(entries.size() - 1);
+        if (idx != last) {
+            slots[slotOfIndex(last)] = idx;
+            entries[idx] = std::move(entries[last]);
+        }
+        entries.pop_back();
+        return true;
+    }
+
+    // Fails if there is nothing at the source or something already at the destination.
+    bool move(int fromX, int fromY, int toX, int toY) {
+        size_t s = findSlot(fromX, fromY);
+        if (s == size_t(-1) || contains(toX, toY)) return false;
+        uint32_t idx = slots[s];
+        clearSlot(s);
+        entries[idx].x = toX;
+        entries[idx].y = toY;
+        placeSlot(idx);
+        return true;
+    }
+
+    void clear() {
+        entries.clear();
+        std::fill(slots.begin(), slots.end(), EMPTY_SLOT);
+    }
+
+    // Calls fn(x, y, value) for everything in [x0, x1) x [y0, y1). Probes cell by cell when the
+    // rectangle is smaller than the population and scans the dense entries otherwise.
+    template <typename Fn>
+    void forEachInRect(int x0, int y0, int x1, int y1, Fn&& fn) {
+        if (x0 >= x1 || y0 >= y1) return;
+        uint64_t area = uint64_t(x1 - x0) * uint64_t(y1 - y0);
+        if (area < entries.size()) {
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    if (T* value = find(x, y)) fn(x, y, *value);
+                }
+            }
+        } else {
+            for (auto& e : entries) {
+                if (e.x >= x0 && e.x < x1 && e.y >= y0 && e.y < y1) fn(e.x, e.y, e.value);
+            }
+        }
+    }
+
+    // Calls fn(x, y, value) for everything within Euclidean distance `radius` of (cx, cy).
+    template <typename Fn>
+    void forEachInRadius(int cx, int cy, int radius, Fn&& fn) {
+        int64_t r2 = int64_t(radius) * radius;
+        forEachInRect(cx - radius, cy - radius, cx + radius + 1, cy + radius + 1, [&](int x, int y, T& value) {
+            int64_t dx = x - cx, dy = y - cy;
+            if (dx * dx + dy * dy <= r2) fn(x, y, value);
+        });
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    typename std::pmr::vector<Entry>::iterator begin() { return entries.begin(); }
+    typename std::pmr::vector<Entry>::iterator end() { return entries.end(); }
+    typename std::pmr::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+    typename std::pmr::vector<Entry>::const_iterator end() const { return entries.end(); }
+};
+
+// A SpatialIndex per REGION_SIZE x REGION_SIZE block of the map, so each region's contents can
+// be changed by its own thread. Region edges fall on Map word boundaries, so two regions never
+// share a tile word either. Visiting order is region by region in row-major order; a map no
+// bigger than one region behaves exactly like a single SpatialIndex.
+template <typename T>
+class RegionIndex {
+public:
+    static constexpr int REGION_SIZE = 128;
+    static_assert(REGION_SIZE % Map::TILES_PER_WORD == 0, "regions must not share tile words");
+
+private:
+    std::pmr::memory_resource* resource;
+    std::pmr::vector<SpatialIndex<T>> shards;
+    int regionsX = 1;
+    int regionsY = 1;
+    size_t count = 0;
+
+    // Cells outside the map go to the nearest region; they are never stored, only looked up.
+    int regionAt(int x, int y) const {
+        int rx = std::clamp(x / REGION_SIZE, 0, regionsX - 1);
+        int ry = std::clamp(y / REGION_SIZE, 0, regionsY - 1);
+        return ry * regionsX + rx;
+    }
+
+public:
+    explicit RegionIndex(std::pmr::memory_resource* r = std::pmr::get_default_resource())
+        : resource(r), shards(r) {
+        shards.emplace_back(resource);
+    }
+
+    // Empties the index and sizes it for a width x height map.
+    void reset(int width, int height) {
+        regionsX = std::max((width + REGION_SIZE - 1) / REGION_SIZE, 1);
+        regionsY = std::max((height + REGION_SIZE - 1) / REGION_SIZE, 1);
+        shards.clear();
+        for (int i = 0; i < regionsX * regionsY; ++i) shards.emplace_back(resource);
+        count = 0;
+    }
+
+    int regionCount() const { return regionsX * regionsY; }
+    int regionColumns() const { return regionsX; }
+    int regionRows() const { return regionsY; }
+    int regionOf(int x, int y) const { return regionAt(x, y); }
+    SpatialIndex<T>& region(int r) { return shards[r]; }
+
+    void reserve(size_t total) {
+        for (auto& shard : shards) shard.reserve(total / shards.size() + 1);
+    }
+
+    T* find(int x, int y) { return shards[regionAt(x, y)].find(x, y); }
+    const T* find(int x, int y) const { return shards[regionAt(x, y)].find(x, y); }
+    bool contains(int x, int y) const { return shards[regionAt(x, y)].contains(x, y); }
+
+    void insertUnique(int x, int y, T value) {
+        shards[regionAt(x, y)].insertUnique(x, y, std::move(value));
+        ++count;
+    }
+
+    bool erase(int x, int y) {
+        if (!shards[regionAt(x, y)].erase(x, y)) return false;
+        --count;
+        return true;
+    }
+
+    bool move(int fromX, int fromY, int toX, int toY) {
+        int from = regionAt(fromX, fromY), to = regionAt(toX, toY);
+        if (from == to) return shards[from].move(fromX, fromY, toX, toY);
+        T* value = shards[from].find(fromX, fromY);
+        if (!value || shards[to].contains(toX, toY)) return false;
+        shards[to].insertUnique(toX, toY, std::move(*value));
+        shards[from].erase(fromX, fromY);
+        return true;
+    }
+
+    void clear() {
+        for (auto& shard : shards) shard.clear();
+        count = 0;
+    }
+
+    template <typename Fn>
+    void forEachInRect(int x0, int y0, int x1, int y1, Fn&& fn) {
+        if (x0 >= x1 || y0 >= y1) return;
+        int first = regionAt(x0, y0), last = regionAt(x1 - 1, y1 - 1);
+        for (int ry = first / regionsX; ry <= last / regionsX; ++ry) {
+            for (int rx = first % regionsX; rx <= last % regionsX; ++rx) {
+                shards[ry * regionsX + rx].forEachInRect(x0, y0, x1, y1, fn);
+            }
+        }
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const auto& shard : shards) {
+            for (const auto& entry : shard) fn(entry.x, entry.y, entry.value);
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// Distance from the hero to every cell of a square window centred on the hero, shared by all
+// hunting enemies: each one just steps to a neighbour one closer. The window is rebuilt with a
+// BFS when the hero moves; single-tile wall changes logged by the Map are repaired in place.
+class FlowField {
+public:
+    static constexpr uint16_t UNREACHED = 0xFFFF;
+
+private:
+    int radius;
+    int side;
+    int originX = 0;
+    int originY = 0;
+    int heroX = 0;
+    int heroY = 0;
+    bool built = false;
+    uint64_t wallVersion = 0;
+    std::vector<uint16_t> dist;
+    std::vector<uint32_t> queue;
+    std::vector<std::pair<uint32_t, uint16_t>> invalidated;
+    uint64_t rebuilds = 0;
+    uint64_t repairs = 0;
+
+    static constexpr int DX[4] = { 0, 1, 0, -1 };
+    static constexpr int DY[4] = { -1, 0, 1, 0 };
+
+    bool inWindow(int x, int y) const {
+        return x >= originX && x < originX + side && y >= originY && y < originY + side;
+    }
+
+    uint32_t cellOf(int x, int y) const {
+        return uint32_t(y - originY) * side + uint32_t(x - originX);
+    }
+
+    // Label-correcting relaxation from whatever is in `queue`: labels only ever decrease, so
+    // cells can be seeded in any order.
+    void relax(const Map& map) {
+        for (size_t head = 0; head < queue.size(); ++head) {
+            uint32_t cell = queue[head];
+            int x = originX + int(cell % side);
+            int y = originY + int(cell / side);
+            uint16_t next = uint16_t(dist[cell] + 1);
+            for (int d = 0; d < 4; ++d) {
+                int nx = x + DX[d], ny = y + DY[d];
+                if (!inWindow(nx, ny) || map.getTile(nx, ny) == TileType::WALL) continue;
+                uint32_t n = cellOf(nx, ny);
+                if (dist[n] > next) {
+                    dist[n] = next;
+                    queue.push_back(n);
+                }
+            }
+        }
+        queue.clear();
+    }
+
+    void rebuild(const Map& map) {
+        originX = heroX - radius;
+        originY = heroY - radius;
+        std::fill(dist.begin(), dist.end(), UNREACHED);
+        uint32_t hero = cellOf(heroX, heroY);
+        dist[hero] = 0;
+        queue.clear();
+        queue.push_back(hero);
+        relax(map);
+        ++rebuilds;
+    }
+
+    uint16_t bestNeighbour(const Map& map, int x, int y) const {
+        uint16_t best = UNREACHED;
+        for (int d = 0; d < 4; ++d) {
+            int nx = x + DX[d], ny = y + DY[d];
+            if (!inWindow(nx, ny) || map.getTile(nx, ny) == TileType::WALL) continue;
+            best = std::min(best, dist[cellOf(nx, ny)]);
+        }
+        return best;
+    }
+
+    // A wall opened at (x, y): it may now offer a shorter route to its neighbourhood.
+    void lower(const Map& map, int x, int y) {
+        uint32_t cell = cellOf(x, y);
+        uint16_t best = bestNeighbour(map, x, y);
+        if (best == UNREACHED || uint16_t(best + 1) >= dist[cell]) return;
+        dist[cell] = uint16_t(best + 1);
+        queue.push_back(cell);
+        relax(map);
+    }
+
+    // A wall closed at (x, y): drop every cell whose only shortest routes ran through it, then
+    // re-seed those cells from their surviving neighbours.
+    void raise(const Map& map, int x, int y) {
+        uint32_t cell = cellOf(x, y);
+        if (dist[cell] == UNREACHED) return;
+        invalidated.clear();
+        invalidated.emplace_back(cell, dist[cell]);
+        dist[cell] = UNREACHED;
+        for (size_t i = 0; i < invalidated.size(); ++i) {
+            uint32_t u = invalidated[i].first;
+            uint16_t oldDist = invalidated[i].second;
+            int ux = originX + int(u % side), uy = originY + int(u / side);
+            for (int d = 0; d < 4; ++d) {
+                int vx = ux + DX[d], vy = uy + DY[d];
+                if (!inWindow(vx, vy)) continue;
+                uint32_t v = cellOf(vx, vy);
+                if (dist[v] == UNREACHED || dist[v] != oldDist + 1) continue;
+                if (bestNeighbour(map, vx, vy) == uint16_t(dist[v] - 1)) continue;
+                invalidated.emplace_back(v, dist[v]);
+                dist[v] = UNREACHED;
+            }
+        }
+        for (size_t i = 1; i < invalidated.size(); ++i) {
+            uint32_t v = invalidated[i].first;
+            uint16_t best = bestNeighbour(map, originX + int(v % side), originY + int(v / side));
+            if (best != UNREACHED && uint16_t(best + 1) < dist[v]) {
+                dist[v] = uint16_t(best + 1);
+                queue.push_back(v);
+            }
+        }
+        relax(map);
+    }
+
+public:
+    explicit FlowField(int windowRadius)
+        : radius(std::max(windowRadius, 1)), side(2 * radius + 1), dist(size_t(side) * side, UNREACHED) {}
+
+    void update(const Map& map, int hx, int hy) {
+        if (!built || hx != heroX || hy != heroY || map.getWallVersion() - wallVersion > Map::WALL_LOG_SIZE) {
+            heroX = hx;
+            heroY = hy;
+            built = true;
+            wallVersion = map.getWallVersion();
+            rebuild(map);
+            return;
+        }
+        for (; wallVersion < map.getWallVersion(); ++wallVersion) {
+            int x, y;
+            if (!map.wallChangeAt(wallVersion, x, y) || !inWindow(x, y)) continue;
+            if (x == heroX && y == heroY) continue;
+            if (map.getTile(x, y) == TileType::WALL) raise(map, x, y);
+            else lower(map, x, y);
+            ++repairs;
+        }
+    }
+
+    uint16_t distanceAt(int x, int y) const {
+        return inWindow(x, y) ? dist[cellOf(x, y)] : UNREACHED;
+    }
+
+    // The neighbour one step closer to the hero, trying directions in a fixed order.
+    bool stepToward(int x, int y, int& nx, int& ny) const {
+        uint16_t here = distanceAt(x, y);
+        if (here == UNREACHED || here == 0) return false;
+        for (int d = 0; d < 4; ++d) {
+            if (distanceAt(x + DX[d], y + DY[d]) == here - 1) {
+                nx = x + DX[d];
+                ny = y + DY[d];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int getRadius() const { return radius; }
+    int getOriginX() const { return originX; }
+    int getOriginY() const { return originY; }
+    int getSide() const { return side; }
+    uint64_t getRebuilds() const { return rebuilds; }
+    uint64_t getRepairs() const { return repairs; }
+};
+
+// A* over the 4-connected grid for one-off queries the flow field cannot answer. Walls block;
+// everything else is passable. JPS would not help here: it needs diagonal moves to prune.
+class PathFinder {
+private:
+    struct Open {
+        int f;
+        int g;
+        uint64_t key;
+        bool operator>(const Open& other) const { return f > other.f || (f == other.f && g < other.g); }
+    };
+
+    std::pmr::vector<Open> open;
+    std::pmr::unordered_map<uint64_t, std::pair<int, uint64_t>> visited;
+    size_t expanded = 0;
+
+    static uint64_t key(int x, int y) { return (uint64_t(uint32_t(x)) << 32) | uint32_t(y); }
+    static int keyX(uint64_t k) { return int(uint32_t(k >> 32)); }
+    static int keyY(uint64_t k) { return int(uint32_t(k)); }
+
+public:
+    explicit PathFinder(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : open(resource), visited(resource) {}
+
+    // Fills `path` with the cells after the start up to and including the goal. Gives up after
+    // expanding `maxNodes` cells.
+    bool findPath(const Map& map, int sx, int sy, int gx, int gy, std::vector<std::pair<int, int>>& path,
+                  size_t maxNodes = 4096) {
+        static constexpr int DX[4] = { 0, 1, 0, -1 };
+        static constexpr int DY[4] = { -1, 0, 1, 0 };
+        path.clear();
+        open.clear();
+        visited.clear();
+        uint64_t start = key(sx, sy), goal = key(gx, gy);
+        auto heuristic = [&](int x, int y) { return std::abs(x - gx) + std::abs(y - gy); };
+        visited[start] = std::make_pair(0, start);
+        open.push_back(Open{heuristic(sx, sy), 0, start});
+        expanded = 0;
+        while (!open.empty() && expanded < maxNodes) {
+            std::pop_heap(open.begin(), open.end(), std::greater<Open>());
+            Open current = open.back();
+            open.pop_back();
+            if (current.g > visited[current.key].first) continue;
+            if (current.key == goal) {
+                for (uint64_t k = goal; k != start; k = visited[k].second) path.emplace_back(keyX(k), keyY(k));
+                std::reverse(path.begin(), path.end());
+                return true;
+            }
+            ++expanded;
+            int x = keyX(current.key), y = keyY(current.key);
+            for (int d = 0; d < 4; ++d) {
+                int nx = x + DX[d], ny = y + DY[d];
+                if (map.getTile(nx, ny) == TileType::WALL) continue;
+                uint64_t k = key(nx, ny);
+                int g = current.g + 1;
+                auto it = visited.find(k);
+                if (it != visited.end() && it->second.first <= g) continue;
+                visited[k] = std::make_pair(g, current.key);
+                open.push_back(Open{g + heuristic(nx, ny), g, k});
+                std::push_heap(open.begin(), open.end(), std::greater<Open>());
+            }
+        }
+        return false;
+    }
+
+    // Cells expanded by the last findPath call.
+    size_t lastExpanded() const { return expanded; }
+};
+
+// What the hero can see within `radius` tiles, by recursive shadowcasting over the eight
+// octants. Walls and visibility are bitsets over a square window around the hero, one bit per
+// tile, so the wall mask is loaded from the Map a word at a time and visible tiles of a type
+// are found by ANDing whole words. Results are kept until the hero moves or a wall changes.
+class FieldOfView {
+private:
+    int radius;
+    int side;
+    int wordsPerRow;
+    int originX = 0;
+    int originY = 0;
+    int heroX = 0;
+    int heroY = 0;
+    bool valid = false;
+    uint64_t wallVersion = 0;
+    std::vector<uint64_t> walls;
+    std::vector<uint64_t> visible;
+    uint64_t computations = 0;
+
+    bool testBit(const std::vector<uint64_t>& bits, int lx, int ly) const {
+        return (bits[size_t(ly) * wordsPerRow + lx / 64] >> (lx % 64)) & 1;
+    }
+
+    void setVisible(int lx, int ly) {
+        visible[size_t(ly) * wordsPerRow + lx / 64] |= uint64_t(1) << (lx % 64);
+    }
+
+    // Octant transform (xx, xy, yx, yy) maps (column, row) offsets into window offsets.
+    void castLight(int row, double start, double end, int xx, int xy, int yx, int yy) {
+        if (start < end) return;
+        double newStart = 0.0;
+        for (int j = row; j <= radius; ++j) {
+            bool blocked = false;
+            for (int dx = -j, dy = -j; dx <= 0; ++dx) {
+                double leftSlope = (dx - 0.5) / (dy + 0.5);
+                double rightSlope = (dx + 0.5) / (dy - 0.5);
+                if (start < rightSlope) continue;
+                if (end > leftSlope) break;
+                int lx = radius + dx * xx + dy * xy;
+                int ly = radius + dx * yx + dy * yy;
+                if (dx * dx + dy * dy <= radius * radius) setVisible(lx, ly);
+                bool wall = testBit(walls, lx, ly);
+                if (blocked) {
+                    if (wall) {
+                        newStart = rightSlope;
+                    } else {
+                        blocked = false;
+                        start = newStart;
+                    }
+                } else if (wall && j < radius) {
+                    blocked = true;
+                    castLight(j + 1, start, leftSlope, xx, xy, yx, yy);
+                    newStart = rightSlope;
+                }
+            }
+            if (blocked) break;
+        }
+    }
+
+    void compute(const Map& map) {
+        originX = heroX - radius;
+        originY = heroY - radius;
+        for (int ly = 0; ly < side; ++ly) {
+            uint64_t* row = &walls[size_t(ly) * wordsPerRow];
+            for (int w = 0; w < wordsPerRow; ++w) row[w] = map.tileBits(originX + w * 64, originY + ly, TileType::WALL);
+        }
+        std::fill(visible.begin(), visible.end(), 0);
+        setVisible(radius, radius);
+        static constexpr int OCTANTS[8][4] = {
+            { 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+            { -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 },
+        };
+        for (const auto& o : OCTANTS) castLight(1, 1.0, 0.0, o[0], o[1], o[2], o[3]);
+        ++computations;
+    }
+
+public:
+    explicit FieldOfView(int sightRadius)
+        : radius(std::max(sightRadius, 1)), side(2 * radius + 1), wordsPerRow((side + 63) / 64),
+          walls(size_t(side) * wordsPerRow, 0), visible(size_t(side) * wordsPerRow, 0) {}
+
+    // Recomputes only if the hero moved or any wall changed since the last call.
+    void update(const Map& map, int hx, int hy) {
+        if (valid && hx == heroX && hy == heroY && map.getWallVersion() == wallVersion) return;
+        heroX = hx;
+        heroY = hy;
+        wallVersion = map.getWallVersion();
+        valid = true;
+        compute(map);
+    }
+
+    bool isVisible(int x, int y) const {
+        int lx = x - originX, ly = y - originY;
+        if (!valid || lx < 0 || ly < 0 || lx >= side || ly >= side) return false;
+        return testBit(visible, lx, ly);
+    }
+
+    // Calls fn(x, y) for every visible tile of `type`, a window word at a time.
+    template <typename Fn>
+    void forEachVisible(const Map& map, TileType type, Fn&& fn) const {
+        if (!valid) return;
+        for (int ly = 0; ly < side; ++ly) {
+            const uint64_t* row = &visible[size_t(ly) * wordsPerRow];
+            for (int w = 0; w < wordsPerRow; ++w) {
+                if (!row[w]) continue;
+                uint64_t hits = row[w] & map.tileBits(originX + w * 64, originY + ly, type);
+                while (hits) {
+                    int bit = __builtin_ctzll(hits);
+                    hits &= hits - 1;
+                    fn(originX + w * 64 + bit, originY + ly);
+                }
+            }
+        }
+    }
+
+    size_t countVisible() const {
+        size_t count = 0;
+        for (uint64_t word : visible) count += __builtin_popcountll(word);
+        return count;
+    }
+
+    int getRadius() const { return radius; }
+    uint64_t getComputations() const { return computations; }
+};
+
+// Keeps what is on the terminal (front) and what the next frame should look like (back),
+// and on present() writes only the cells that differ, in a single write() call.
+class TerminalRenderer {
+private:
+    int cols;
+    int rows;
+    std::vector<char> front;
+    std::vector<char> back;
+    std::string frame;
+    bool headless;
+    TextSink* sink = nullptr;
+    bool fullRedraw;
+    int cursorX;
+    int cursorY;
+    size_t bytesEmitted;
+    size_t framesPresented;
+
+    static void appendCursorMove(std::string& out, int x, int y) {
+        char buf[24];
+        int n = std::snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
+        out.append(buf, n);
+    }
+
+    void emit(const std::string& bytes) {
+        bytesEmitted += bytes.size();
+        if (headless || bytes.empty()) return;
+        if (sink) {
+            sink->write(bytes.data(), bytes.size());
+            return;
+        }
+        MessageLog::sync();
+        std::cout.flush();
+#ifdef _WIN32
+        std::fwrite(bytes.data(), 1, bytes.size(), stdout);
+        std::fflush(stdout);
+#else
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = ::write(STDOUT_FILENO, bytes.data() + written, bytes.size() - written);
+            if (n <= 0) break;
+            written += size_t(n);
+        }
+#endif
+    }
+
+public:
+    TerminalRenderer(int c, int r, bool headlessMode = false)
+        : cols(c), rows(r), front(size_t(c) * r, ' '), back(size_t(c) * r, ' '),
+          headless(headlessMode), fullRedraw(true), cursorX(0), cursorY(0),
+          bytesEmitted(0), framesPresented(0) {
+        frame.reserve(front.size() * 2);
+    }
+
+    // Frames go to `target` instead of stdout; null switches back.
+    void setSink(TextSink* target) {
+        sink = target;
+    }
+
+    void clear() {
+        std::fill(back.begin(), back.end(), ' ');
+    }
+
+    void drawText(int x, int y, std::string_view text) {
+        if (y < 0 || y >= rows) return;
+        for (size_t i = 0; i < text.size(); ++i) {
+            int cx = x + int(i);
+            if (cx < 0) continue;
+            if (cx >= cols) break;
+            back[size_t(y) * cols + cx] = text[i];
+        }
+    }
+
+    // Draws the viewW x viewH block of tiles whose top-left tile is (originX, originY),
+    // two columns per tile, starting at screen cell (left, top).
+    // With `sight`, tiles the hero cannot see are left blank.
+    void drawMap(const Map& map, int left, int top, int originX, int originY, int viewW, int viewH,
+                 const FieldOfView* sight = nullptr) {
+        static const char glyphs[] = { '.', '#', 'H', 'E' };
+        for (int vy = 0; vy < viewH && top + vy < rows; ++vy) {
+            int my = originY + vy;
+            if (my < 0 || my >= map.getHeight()) continue;
+            char* row = &back[size_t(top + vy) * cols];
+            for (int vx = 0; vx < viewW; ++vx) {
+                int mx = originX + vx;
+                int sx = left + vx * 2;
+                if (sx + 1 >= cols) break;
+                if (mx < 0 || mx >= map.getWidth()) continue;
+                row[sx] = sight && !sight->isVisible(mx, my) ? ' ' : glyphs[static_cast<int>(map.getTileUnchecked(mx, my))];
+                row[sx + 1] = ' ';
+            }
+        }
+    }
+
+    void setCursor(int x, int y) {
+        cursorX = x;
+        cursorY = y;
+    }
+
+    // Something other than the renderer wrote to the terminal; the next frame repaints everything.
+    void invalidate() {
+        fullRedraw = true;
+    }
+
+    size_t present() {
+        frame.clear();
+        if (fullRedraw) {
+            frame += "\x1b[H\x1b[2J";
+            std::fill(front.begin(), front.end(), ' ');
+            fullRedraw = false;
+        }
+        for (int y = 0; y < rows; ++y) {
+            const char* b = &back[size_t(y) * cols];
+            char* f = &front[size_t(y) * cols];
+            int x = 0;
+            while (x < cols) {
+                if (b[x] == f[x]) { ++x; continue; }
+                // Short unchanged gaps are cheaper to rewrite than to skip with another cursor move.
+                int end = x + 1;
+                int lastChanged = x;
+                while (end < cols && end - lastChanged <= 4) {
+                    if (b[end] != f[end]) lastChanged = end;
+                    ++end;
+                }
+                appendCursorMove(frame, x, y);
+                frame.append(b + x, size_t(lastChanged - x + 1));
+                std::copy(b + x, b + lastChanged + 1, f + x);
+                x = lastChanged + 1;
+            }
+        }
+        appendCursorMove(frame, cursorX, cursorY);
+        emit(frame);
+        ++framesPresented;
+        return frame.size();
+    }
+
+    int getCols() const { return cols; }
+    int getRows() const { return rows; }
+    bool isHeadless() const { return headless; }
+    size_t getBytesEmitted() const { return bytesEmitted; }
+    size_t getFramesPresented() const { return framesPresented; }
+};
+
+class Aether : public Character {
+public:
+    Aether() : Character(NameId::AETHER, 65, 80, AETHER_ABILITIES) {}
+    void displayInfo() const override {
+        logMessage<MessageLog::NOTICE>("The name is {} and the health is {}\n", getName(), health);
+        logMessage<MessageLog::NOTICE>("Aether is smartest person in the universe, he made a object with magic called Sphere of Everything. I believe object's name is clear\n");
+    }
+};
+
+class Synax : public Character {
+public:
+    Synax() : Character(NameId::SYNAX, 76, 110, SYNAX_ABILITIES) {}
+    void displayInfo() const override {
+        logMessage<MessageLog::NOTICE>("The name is {} and the health is {}\n", getName(), health);
+        logMessage<MessageLog::NOTICE>("Synax is a princess, she has special eyes. She can kill everything she can see\n");
+    }
+};
+
+class Kahray : public Character {
+public:
+    Kahray() : Character(NameId::KAHRAY, 120, 150, KAHRAY_ABILITIES) {}
+    void displayInfo() const override {
+        logMessage<MessageLog::NOTICE>("The name is {} and the health is {}\n", getName(), health);
+        logMessage<MessageLog::NOTICE>("Kahray is a warrior, he has a sword. He can protect himself and his friends\n");
+    }
+};
+
+class Yroy : public Character {
+public:
+    Yroy() : Character(NameId::YROY, 50, 55, YROY_ABILITIES) {}
+    void displayInfo() const override {
+        logMessage<MessageLog::NOTICE>("The name is {} and the health is {}\n", getName(), health);
+        logMessage<MessageLog::NOTICE>("Yroy is a child, he wants to be a hero. He is not strong, but he is smart and his idol is Aether\n");
+    }
+};
+
+class Batley : public Character {
+public:
+    Batley() : Character(NameId::BATLEY, 80, 90, BATLEY_ABILITIES) {}
+    void displayInfo() const override {
+        logMessage<MessageLog::NOTICE>("The name is {} and the health is {}\n", getName(), health);
+        logMessage<MessageLog::NOTICE>("What a old man. In past, he was a great warrior. But now, he is old and weak. He can not fight anymore, but universe need him\n");
+    }
+};
+
+enum class EnemyKind : uint8_t {
+    SKELETON = 0,
+    WITCH,
+    KHEON
+};
+
+struct EnemyKindInfo {
+    NameId name;
+    int health;
+    int maxHealth;
+    int regenPerTick;
+    const char* description;
+    AbilitySet abilities;
+};
+
+inline constexpr EnemyKindInfo ENEMY_KINDS[] = {
+    { NameId::SKELETON, 40, 40, 0, "A Skeleton, a mindless creature, it attacks anything that moves.",
+      { "", "", 1, { BONE_CRUSH } } },
+    { NameId::WITCH, 60, 65, 1, "A Witch, she casts dark spells to weaken her enemies.",
+      { "", "", 2, { DEATH_MAGIC, CURSE } } },
+    { NameId::KHEON, 70, 125, 2, "Kheon and Aether, they were friends. When Kheon's love Oix is dead, Kheon wanted use Sphere of Everything to bring her to life but Aether was against that idea",
+      { "", "", 3, { BURN_EVERYTHING, FIRE_SHIELD, BURN_MAP } } },
+};
+
+inline constexpr int ENEMY_KIND_COUNT = sizeof(ENEMY_KINDS) / sizeof(ENEMY_KINDS[0]);
+
+using EntityId = uint32_t;
+
+// Enemies stored as parallel arrays. Ids stay stable for an enemy's lifetime; the arrays are
+// kept dense by moving the last enemy into a destroyed one's slot, so batch passes over them
+// are straight loops over contiguous ints.
+class EnemyStore {
+private:
+    std::pmr::vector<int> health;
+    std::pmr::vector<int> maxHealth;
+    std::pmr::vector<int> regen;
+    std::pmr::vector<EnemyKind> kind;
+    std::pmr::vector<int> posX;
+    std::pmr::vector<int> posY;
+    // The tick each enemy's health was last brought up to date; regeneration since then is
+    // owed and applied in one step when the health is next needed.
+    std::pmr::vector<uint64_t> settledAt;
+    std::pmr::vector<EntityId> idOfSlot;
+    std::pmr::vector<uint32_t> slotOfId;
+    std::pmr::vector<EntityId> freeIds;
+    uint64_t now = 0;
+
+    static constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+    // Health after `ticks` ticks of regeneration, exactly as that many single ticks would
+    // leave it: living enemies gain `regen` a tick up to their maximum.
+    static int regenerated(int health, int maxHealth, int regen, uint64_t ticks) {
+        if (ticks == 0) return health;
+        if (health <= 0) return 0;
+        int64_t grown = health + int64_t(regen) * int64_t(std::min<uint64_t>(ticks, uint64_t(1) << 31));
+        return int(std::min<int64_t>(grown, maxHealth));
+    }
+
+public:
+    explicit EnemyStore(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : health(resource), maxHealth(resource), regen(resource), kind(resource), posX(resource), posY(resource),
+          settledAt(resource), idOfSlot(resource), slotOfId(resource), freeIds(resource) {}
+
+    void reserve(size_t count) {
+        health.reserve(count);
+        maxHealth.reserve(count);
+        regen.reserve(count);
+        kind.reserve(count);
+        posX.reserve(count);
+        posY.reserve(count);
+        settledAt.reserve(count);
+        idOfSlot.reserve(count);
+        slotOfId.reserve(count);
+    }
+
+    EntityId create(EnemyKind k, int x, int y) {
+        const EnemyKindInfo& info = ENEMY_KINDS[static_cast<int>(k)];
+        EntityId id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        } else {
+            id = EntityId(slotOfId.size());
+            slotOfId.push_back(NO_SLOT);
+        }
+        slotOfId[id] = uint32_t(health.size());
+        health.push_back(info.health);
+        maxHealth.push_back(info.maxHealth);
+        regen.push_back(info.regenPerTick);
+        kind.push_back(k);
+        posX.push_back(x);
+        posY.push_back(y);
+        settledAt.push_back(now);
+        idOfSlot.push_back(id);
+        return id;
+    }
+
+    void destroy(EntityId id) {
+        uint32_t slot = slotOfId[id];
+        uint32_t last = uint32_t(health.size() - 1);
+        if (slot != last) {
+            health[slot] = health[last];
+            maxHealth[slot] = maxHealth[last];
+            regen[slot] = regen[last];
+            kind[slot] = kind[last];
+            posX[slot] = posX[last];
+            posY[slot] = posY[last];
+            settledAt[slot] = settledAt[last];
+            idOfSlot[slot] = idOfSlot[last];
+            slotOfId[idOfSlot[slot]] = slot;
+        }
+        health.pop_back();
+        maxHealth.pop_back();
+        regen.pop_back();
+        kind.pop_back();
+        posX.pop_back();
+        posY.pop_back();
+        settledAt.pop_back();
+        idOfSlot.pop_back();
+        slotOfId[id] = NO_SLOT;
+        freeIds.push_back(id);
+    }
+
+    // Forgets every enemy but keeps the storage.
+    void clear() {
+        health.clear();
+        maxHealth.clear();
+        regen.clear();
+        kind.clear();
+        posX.clear();
+        posY.clear();
+        settledAt.clear();
+        idOfSlot.clear();
+        slotOfId.clear();
+        freeIds.clear();
+    }
+
+    bool contains(EntityId id) const {
+        return id < slotOfId.size() && slotOfId[id] != NO_SLOT;
+    }
+
+    // References stay valid until the next create() or destroy(). The health is as of the
+    // last settle(); whether it is above zero is always current.
+    int& healthOf(EntityId id) { return health[slotOfId[id]]; }
+    int healthOf(EntityId id) const { return health[slotOfId[id]]; }
+
+    // The health with the regeneration owed so far, without settling it.
+    int currentHealthOf(EntityId id) const {
+        uint32_t slot = slotOfId[id];
+        return regenerated(health[slot], maxHealth[slot], regen[slot], now - settledAt[slot]);
+    }
+    int& maxHealthOf(EntityId id) { return maxHealth[slotOfId[id]]; }
+    EnemyKind kindOf(EntityId id) const { return kind[slotOfId[id]]; }
+    int xOf(EntityId id) const { return posX[slotOfId[id]]; }
+    int yOf(EntityId id) const { return posY[slotOfId[id]]; }
+
+    void setPosition(EntityId id, int x, int y) {
+        posX[slotOfId[id]] = x;
+        posY[slotOfId[id]] = y;
+    }
+
+    // One enemy tick has passed. Nothing is regenerated until settle() or settleAll().
+    void advance() { ++now; }
+
+    void settle(EntityId id) {
+        uint32_t slot = slotOfId[id];
+        health[slot] = regenerated(health[slot], maxHealth[slot], regen[slot], now - settledAt[slot]);
+        settledAt[slot] = now;
+    }
+
+    // Brings every enemy's health up to date in one pass, written as a branch-free loop over
+    // plain ints so the compiler can vectorize it.
+    void settleAll() {
+        int* h = health.data();
+        const int* m = maxHealth.data();
+        const int* r = regen.data();
+        uint64_t* at = settledAt.data();
+        size_t n = health.size();
+        for (size_t i = 0; i < n; ++i) {
+            int64_t ticks = int64_t(std::min<uint64_t>(now - at[i], uint64_t(1) << 31));
+            int64_t v = h[i] + int64_t(r[i]) * ticks;
+            v = v < m[i] ? v : m[i];
+            h[i] = ticks == 0 ? h[i] : h[i] > 0 ? int(v) : 0;
+            at[i] = now;
+        }
+    }
+
+    size_t size() const { return health.size(); }
+    EntityId idAt(size_t slot) const { return idOfSlot[slot]; }
+};
+
+// The Character API over one EnemyStore slot. Behaviour is chosen by the enemy's kind rather
+// than by a subclass. Do not create or destroy enemies while a view is alive.
+class Enemy : public Character {
+private:
+    EnemyKind kind;
+public:
+    Enemy(EnemyStore& store, EntityId id)
+        : Character(ENEMY_KINDS[static_cast<int>(store.kindOf(id))].name, &store.healthOf(id), &store.maxHealthOf(id),
+                    ENEMY_KINDS[static_cast<int>(store.kindOf(id))].abilities),
+          kind(store.kindOf(id)) {}
+
+    void displayInfo() const override {
+        logMessage<MessageLog::NOTICE>("The name is {} and the health is {}\n", getName(), health);
+        logMessage<MessageLog::NOTICE>("{}\n", ENEMY_KINDS[static_cast<int>(kind)].description);
+    }
+
+    EnemyKind getKind() const { return kind; }
+};
+
+struct GameOptions {
+    int mapWidth = 15;
+    int mapHeight = 10;
+    int enemyCount = 3;
+    // Skip all drawing. Headless runs from the command line also turn the MessageLog off.
+    bool headless = false;
+    // Stop after this many exploration moves; 0 means no limit.
+    uint64_t maxMoves = 0;
+    // Seeds the enemies' decisions; 0 picks one from the clock.
+    uint64_t seed = 0;
+    // Enemies within this many tiles of the hero chase it; 0 leaves every enemy in place.
+    int huntRadius = 8;
+    // How far the hero sees, for sight-based abilities and fog of war.
+    int sightRadius = 8;
+    // Draw only the tiles the hero can currently see.
+    bool fog = false;
+    // Resume from this snapshot instead of starting a new game.
+    std::string loadPath;
+    // Save here when the game ends with the hero alive, and every `autosaveMoves` moves if set.
+    std::string savePath;
+    uint64_t autosaveMoves = 0;
+    // Play in an endless streamed world kept under this directory; the map size is ignored.
+    std::string worldDir;
+    // Most world chunks kept in memory at once.
+    size_t worldCache = 64;
+    // Move the enemies every this many milliseconds instead of after each hero move; 0 keeps
+    // the game turn based.
+    int tickMs = 0;
+    // Enemies away from the hero wander a step at a time instead of standing still.
+    bool roam = false;
+    // Threads moving the wandering enemies, region by region; the result does not depend on it.
+    int tickThreads = 1;
+    // Enemies with more than one ability search this many simulated turns ahead to pick one;
+    // 0 picks at random.
+    uint64_t bossSearch = 0;
+    // Only the regions within this many tiles of the hero are simulated each tick; the rest
+    // catch up when the hero comes near. 0 simulates the whole map every tick.
+    int interestRadius = 64;
+};
+
+// Snapshot file layout, version 1, in the byte order of the machine that wrote it:
+//   page 0:            SnapshotHeader, zero padded
+//   tileOffset:        the Map's tile words exactly as held in memory, page aligned so the
+//                      block can be mapped straight back
+//   enemyOffset:       enemyCount EnemyRecords
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t heroChoice;
+    int32_t width;
+    int32_t height;
+    int32_t wordsPerRow;
+    int32_t playerX;
+    int32_t playerY;
+    int32_t heroHealth;
+    int32_t heroMaxHealth;
+    uint32_t enemyCount;
+    uint64_t tileOffset;
+    uint64_t tileBytes;
+    uint64_t enemyOffset;
+    uint64_t tileCounts[4];
+    uint64_t movesProcessed;
+    uint64_t spawnRng[4];
+    uint64_t combatRng[4];
+};
+
+struct EnemyRecord {
+    int32_t x;
+    int32_t y;
+    int32_t health;
+    int32_t maxHealth;
+    uint32_t kind;
+};
+
+static_assert(sizeof(EnemyRecord) == 20, "EnemyRecord is a fixed on-disk size");
+
+constexpr char SNAPSHOT_MAGIC[8] = { 'A', 'N', 'K', 'R', 'S', 'A', 'V', 'E' };
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr uint64_t SNAPSHOT_PAGE = 4096;
+
+// Reads and checks just the header; false if the file is missing or not a snapshot.
+inline bool readSnapshotHeader(const std::string& path, SnapshotHeader& header) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    return std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header.magic) && header.version == SNAPSHOT_VERSION;
+}
+
+// Pushes what has been written to `path` through to the disk, so later writes cannot land
+// before it.
+inline bool syncFile(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+#endif
+}
+
+// An unbounded world cut into square chunks, generated from a seed on first visit. A
+// background thread generates chunks and reads and writes them on disk. The game thread only
+// ever polls for finished chunks, so it never waits on generation or I/O. At most `capacity`
+// chunks stay in memory; beyond that, the least recently used ones far from the hero are
+// written out (if they changed) and dropped.
+class ChunkedWorld {
+public:
+    // One Map word per chunk row, so a chunk lines up with whole words of a window Map.
+    static constexpr int CHUNK_SIZE = Map::TILES_PER_WORD;
+
+    struct Chunk {
+        uint64_t rows[CHUNK_SIZE];
+        // Enemy positions are local to the chunk.
+        std::vector<EnemyRecord> enemies;
+        bool modified = false;
+    };
+
+private:
+    struct Job {
+        bool store;
+        int64_t key;
+        std::unique_ptr<Chunk> chunk;
+    };
+
+    struct Resident {
+        std::unique_ptr<Chunk> chunk;
+        std::list<int64_t>::iterator lru;
+    };
+
+    uint64_t seed;
+    std::string directory;
+    size_t capacity;
+
+    // Game thread only.
+    std::unordered_map<int64_t, Resident> resident;
+    std::list<int64_t> lru;
+    std::unordered_set<int64_t> inFlight;
+
+    // Shared with the worker.
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable chunkReady;
+    std::deque<Job> jobs;
+    std::vector<std::pair<int64_t, std::unique_ptr<Chunk>>> finished;
+    size_t pendingJobs = 0;
+    bool stopping = false;
+    std::atomic<uint64_t> generated{0};
+    std::atomic<uint64_t> loaded{0};
+    std::atomic<uint64_t> stored{0};
+    std::thread worker;
+
+    static constexpr char CHUNK_MAGIC[8] = { 'A', 'N', 'K', 'R', 'C', 'H', 'N', 'K' };
+
+    std::string pathOf(int64_t key) const {
+        return directory + "/c_" + std::to_string(chunkX(key)) + "_" + std::to_string(chunkY(key)) + ".chunk";
+    }
+
+    static void setTile(Chunk& chunk, int x, int y, TileType type) {
+        int shift = x * Map::BITS_PER_TILE;
+        chunk.rows[y] = (chunk.rows[y] & ~(Map::TILE_MASK << shift)) | (uint64_t(type) << shift);
+    }
+
+    static TileType getTile(const Chunk& chunk, int x, int y) {
+        return static_cast<TileType>((chunk.rows[y] >> (x * Map::BITS_PER_TILE)) & Map::TILE_MASK);
+    }
+
+    // Open ground with a few pillars, up to two walled rooms with doorways, and a handful of
+    // enemies. The outer ring of every chunk stays open so neighbouring chunks always connect.
+    std::unique_ptr<Chunk> generate(int64_t key) const {
+        auto chunk = std::make_unique<Chunk>();
+        std::fill(chunk->rows, chunk->rows + CHUNK_SIZE, 0);
+        Rng rng(RngService::mix(seed ^ RngService::mix(uint64_t(key))));
+        int rooms = rng.range(0, 2);
+        for (int r = 0; r < rooms; ++r) {
+            int w = rng.range(6, 13), h = rng.range(6, 13);
+            int x0 = rng.range(2, CHUNK_SIZE - 2 - w), y0 = rng.range(2, CHUNK_SIZE - 2 - h);
+            for (int x = x0; x < x0 + w; ++x) {
+                setTile(*chunk, x, y0, TileType::WALL);
+                setTile(*chunk, x, y0 + h - 1, TileType::WALL);
+            }
+            for (int y = y0; y < y0 + h; ++y) {
+                setTile(*chunk, x0, y, TileType::WALL);
+                setTile(*chunk, x0 + w - 1, y, TileType::WALL);
+            }
+            setTile(*chunk, rng.range(x0 + 1, x0 + w - 2), y0, TileType::EMPTY);
+            setTile(*chunk, rng.range(x0 + 1, x0 + w - 2), y0 + h - 1, TileType::EMPTY);
+            setTile(*chunk, x0, rng.range(y0 + 1, y0 + h - 2), TileType::EMPTY);
+            setTile(*chunk, x0 + w - 1, rng.range(y0 + 1, y0 + h - 2), TileType::EMPTY);
+        }
+        for (int i = rng.range(4, 12); i > 0; --i) {
+            setTile(*chunk, rng.range(1, CHUNK_SIZE - 2), rng.range(1, CHUNK_SIZE - 2), TileType::WALL);
+        }
+        for (int i = rng.range(1, 4); i > 0; --i) {
+            int x = rng.range(1, CHUNK_SIZE - 2), y = rng.range(1, CHUNK_SIZE - 2);
+            if (getTile(*chunk, x, y) != TileType::EMPTY) continue;
+            uint32_t kind = rng.below(ENEMY_KIND_COUNT);
+            const EnemyKindInfo& info = ENEMY_KINDS[kind];
+            chunk->enemies.push_back(EnemyRecord{x, y, info.health, info.maxHealth, kind});
+        }
+        return chunk;
+    }
+
+    std::unique_ptr<Chunk> load(int64_t key) const {
+        std::ifstream in(pathOf(key), std::ios::binary);
+        char magic[8];
+        uint32_t count = 0;
+        auto chunk = std::make_unique<Chunk>();
+        if (!in.read(magic, 8) || !std::equal(CHUNK_MAGIC, CHUNK_MAGIC + 8, magic) ||
+            !in.read(reinterpret_cast<char*>(chunk->rows), sizeof(chunk->rows)) ||
+            !in.read(reinterpret_cast<char*>(&count), sizeof(count)) || count > CHUNK_SIZE * CHUNK_SIZE) {
+            return nullptr;
+        }
+        chunk->enemies.resize(count);
+        if (!in.read(reinterpret_cast<char*>(chunk->enemies.data()), std::streamsize(count * sizeof(EnemyRecord)))) return nullptr;
+        return chunk;
+    }
+
+    void store(int64_t key, const Chunk& chunk) const {
+        std::ofstream out(pathOf(key), std::ios::binary | std::ios::trunc);
+        uint32_t count = uint32_t(chunk.enemies.size());
+        out.write(CHUNK_MAGIC, 8);
+        out.write(reinterpret_cast<const char*>(chunk.rows), sizeof(chunk.rows));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(chunk.enemies.data()), std::streamsize(count * sizeof(EnemyRecord)));
+    }
+
+    // Jobs run in order, so a chunk stored on eviction is on disk before any later load of it.
+    void workerLoop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            std::unique_ptr<Chunk> chunk;
+            if (job.store) {
+                store(job.key, *job.chunk);
+                ++stored;
+            } else if ((chunk = load(job.key))) {
+                ++loaded;
+            } else {
+                chunk = generate(job.key);
+                ++generated;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (chunk) finished.emplace_back(job.key, std::move(chunk));
+            --pendingJobs;
+            chunkReady.notify_all();
+        }
+    }
+
+    void submit(Job job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            ++pendingJobs;
+        }
+        jobReady.notify_one();
+    }
+
+    void evict(int64_t key) {
+        auto it = resident.find(key);
+        if (it->second.chunk->modified) submit(Job{true, key, std::move(it->second.chunk)});
+        lru.erase(it->second.lru);
+        resident.erase(it);
+    }
+
+public:
+    ChunkedWorld(uint64_t worldSeed, const std::string& dir, size_t maxResident)
+        : seed(worldSeed), directory(dir), capacity(std::max<size_t>(maxResident, 1)) {
+        std::filesystem::create_directories(directory);
+        worker = std::thread([this] { workerLoop(); });
+    }
+
+    ~ChunkedWorld() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        worker.join();
+    }
+
+    static int64_t keyOf(int cx, int cy) { return int64_t((uint64_t(uint32_t(cx)) << 32) | uint32_t(cy)); }
+    static int chunkX(int64_t key) { return int(int32_t(uint64_t(key) >> 32)); }
+    static int chunkY(int64_t key) { return int(int32_t(uint32_t(uint64_t(key)))); }
+
+    // Asks for a chunk without waiting for it.
+    void request(int cx, int cy) {
+        int64_t key = keyOf(cx, cy);
+        if (resident.count(key) || inFlight.count(key)) return;
+        inFlight.insert(key);
+        submit(Job{false, key, nullptr});
+    }
+
+    // Moves finished chunks into memory and returns their keys through `arrived`.
+    void poll(std::vector<int64_t>& arrived) {
+        arrived.clear();
+        std::vector<std::pair<int64_t, std::unique_ptr<Chunk>>> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.swap(finished);
+        }
+        for (auto& entry : done) {
+            inFlight.erase(entry.first);
+            lru.push_front(entry.first);
+            resident[entry.first] = Resident{std::move(entry.second), lru.begin()};
+            arrived.push_back(entry.first);
+        }
+    }
+
+    // The chunk if it is in memory, marking it recently used; nullptr otherwise.
+    Chunk* find(int cx, int cy) {
+        auto it = resident.find(keyOf(cx, cy));
+        if (it == resident.end()) return nullptr;
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return it->second.chunk.get();
+    }
+
+    // Only for startup: blocks until the chunk is in memory.
+    Chunk& waitFor(int cx, int cy) {
+        std::vector<int64_t> arrived;
+        request(cx, cy);
+        for (;;) {
+            poll(arrived);
+            if (Chunk* chunk = find(cx, cy)) return *chunk;
+            std::unique_lock<std::mutex> lock(mutex);
+            chunkReady.wait(lock, [this] { return !finished.empty(); });
+        }
+    }
+
+    // Drops least recently used chunks more than `keepRadius` chunks from (cx, cy) until at
+    // most `capacity` remain.
+    void trim(int cx, int cy, int keepRadius) {
+        for (auto it = lru.end(); resident.size() > capacity && it != lru.begin();) {
+            --it;
+            int64_t key = *it;
+            if (std::abs(chunkX(key) - cx) <= keepRadius && std::abs(chunkY(key) - cy) <= keepRadius) continue;
+            it = std::next(it);
+            evict(key);
+        }
+    }
+
+    // Writes every changed chunk in memory and waits until the disk is up to date.
+    void flush() {
+        for (auto& entry : resident) {
+            if (!entry.second.chunk->modified) continue;
+            store(entry.first, *entry.second.chunk);
+            entry.second.chunk->modified = false;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        chunkReady.wait(lock, [this] { return pendingJobs == 0; });
+    }
+
+    size_t residentCount() const { return resident.size(); }
+    uint64_t getGenerated() const { return generated; }
+    uint64_t getLoaded() const { return loaded; }
+    uint64_t getStored() const { return stored; }
+};
+
+// Told about every combat round before the player picks an action.
+class CombatObserver {
+public:
+    virtual ~CombatObserver() {}
+    virtual void onRound(int round, const Character& hero, const Character& enemy) = 0;
+};
+
+inline ArenaPtr<Character> makeHero(int choice, std::pmr::memory_resource* resource = std::pmr::new_delete_resource()) {
+    switch (choice) {
+        case 1: return makeIn<Aether>(resource);
+        case 2: return makeIn<Synax>(resource);
+        case 3: return makeIn<Kahray>(resource);
+        case 4: return makeIn<Yroy>(resource);
+        case 5: return makeIn<Batley>(resource);
+        default: return nullptr;
+    }
+}
+
+class GameManager {
+private:
+    GameOptions options;
+    TerminalInput terminalInput;
+    InputSource* input;
+    bool running;
+    bool quit;
+    RngService rngService;
+    Rng spawnRng;
+    Rng combatRng;
+    CombatObserver* combatObserver;
+    uint64_t movesProcessed;
+    uint64_t combatRounds;
+
+    // Declared before everything that allocates from it, so it is torn down last.
+    LevelArena arena;
+    ArenaPtr<Character> player;
+    EnemyStore enemyStore;
+    RegionIndex<EntityId> enemiesOnMap;
+    // The last few things that happened while exploring, oldest first.
+    static constexpr int MESSAGE_LINES = 3;
+    const char* messages[MESSAGE_LINES] = {};
+
+    Map gameMap;
+    int playerX, playerY;
+    TerminalRenderer renderer;
+
+    FlowField flowField;
+    PathFinder pathFinder;
+    struct Hunter { int x, y; uint16_t dist; };
+    std::pmr::vector<Hunter> hunters;
+    std::pmr::vector<Hunter> huntersByDistance;
+    std::pmr::vector<uint32_t> distanceCounts;
+    std::vector<std::pair<int, int>> path;
+    static constexpr size_t SEARCH_NODES_PER_TICK = 512;
+
+    // Wandering enemies move region by region in three passes (see roamEnemies). Each region
+    // keeps its moves sorted by the direction of the region at the other end: 0 for itself,
+    // then north, south, west and east. The ticks say which pass last wrote each list, since
+    // only the regions near the hero take part in a tick.
+    struct RoamMove { int fromX, fromY, toX, toY; EntityId id; };
+    struct alignas(64) RoamRegion {
+        std::vector<RoamMove> claims[5];
+        std::vector<RoamMove> departures[5];
+        std::vector<RoamMove> gathered;
+        size_t roamers = 0;
+        uint64_t claimedAt = ~0ull;
+        uint64_t listedAt = ~0ull;
+        uint64_t roamedTo = 0;
+    };
+    std::vector<RoamRegion> roamRegions;
+    std::vector<int> activeRegions;
+    std::vector<int> roamTargets;
+    std::unique_ptr<WorkStealingPool> tickPool;
+    uint64_t roamTicks = 0;
+
+    FieldOfView sight;
+    int heroChoice = 0;
+    // The file the map's dirty chunks are relative to: the last snapshot saved or loaded.
+    std::string snapshotPath;
+    size_t lastSaveChunks = 0;
+    size_t bytesReported = 0;
+
+    // Enemies killed outside their own fight stay on the map with no health until the next tick,
+    // so the Enemy view of the current fight keeps pointing at the right slot.
+    std::vector<std::pair<int, int>> slainEnemies;
+
+    // In a streamed world the map is a window of WINDOW_CHUNKS x WINDOW_CHUNKS chunks kept
+    // centred on the hero's chunk; window chunks that have not arrived yet are solid wall.
+    static constexpr int WINDOW_CHUNKS = 3;
+    static constexpr int CHUNK_SIZE = ChunkedWorld::CHUNK_SIZE;
+    std::unique_ptr<ChunkedWorld> world;
+    int windowChunkX = 0;
+    int windowChunkY = 0;
+    bool windowBuilt = false;
+    std::vector<int64_t> arrivedChunks;
+
+    static constexpr int VIEW_WIDTH = 38;
+    static constexpr int VIEW_HEIGHT = 18;
+
+    // A resumed game maps its own tiles, so only a placeholder is built until runGame; a
+    // streamed world always uses its fixed window.
+    static int initialMapSize(const GameOptions& o, int requested) {
+        if (!o.worldDir.empty()) return WINDOW_CHUNKS * CHUNK_SIZE;
+        if (!o.loadPath.empty()) return Map::MIN_SIDE;
+        return std::max(requested, Map::MIN_SIDE);
+    }
+
+    static int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+    // Copies one window chunk back into the world, enemies included.
+    void storeWindowChunk(int wx, int wy) {
+        ChunkedWorld::Chunk* chunk = world->find(windowChunkX + wx, windowChunkY + wy);
+        if (!chunk) return;
+        int x0 = wx * CHUNK_SIZE, y0 = wy * CHUNK_SIZE;
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            uint64_t word = gameMap.getWord(wx, y0 + y);
+            uint64_t occupied = Map::matchLanes(word, TileType::HERO) | Map::matchLanes(word, TileType::ENEMY);
+            chunk->rows[y] = word & ~(occupied * Map::TILE_MASK);
+        }
+        chunk->enemies.clear();
+        enemiesOnMap.forEachInRect(x0, y0, x0 + CHUNK_SIZE, y0 + CHUNK_SIZE, [&](int x, int y, EntityId id) {
+            chunk->enemies.push_back(EnemyRecord{x - x0, y - y0, enemyStore.currentHealthOf(id), enemyStore.maxHealthOf(id),
+                                                 uint32_t(enemyStore.kindOf(id))});
+        });
+        chunk->modified = true;
+    }
+
+    // Copies one world chunk into the window, or walls the area off if it has not arrived.
+    void loadWindowChunk(int wx, int wy) {
+        ChunkedWorld::Chunk* chunk = world->find(windowChunkX + wx, windowChunkY + wy);
+        int x0 = wx * CHUNK_SIZE, y0 = wy * CHUNK_SIZE;
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            gameMap.setWord(wx, y0 + y, chunk ? chunk->rows[y] : Map::broadcast(TileType::WALL));
+        }
+        if (!chunk) return;
+        bool hasHero = playerX >= x0 && playerX < x0 + CHUNK_SIZE && playerY >= y0 && playerY < y0 + CHUNK_SIZE;
+        if (hasHero) gameMap.setTile(playerX, playerY, TileType::HERO);
+        for (const EnemyRecord& record : chunk->enemies) {
+            if (record.kind >= ENEMY_KIND_COUNT || !placeEnemy(x0 + record.x, y0 + record.y, static_cast<EnemyKind>(record.kind))) continue;
+            EntityId id = *enemiesOnMap.find(x0 + record.x, y0 + record.y);
+            enemyStore.healthOf(id) = record.health;
+            enemyStore.maxHealthOf(id) = record.maxHealth;
+        }
+    }
+
+    // Re-centres the window on the chunk holding the hero at world position (heroX, heroY).
+    void rebuildWindow(int heroX, int heroY) {
+        removeSlainEnemies();
+        if (windowBuilt) {
+            for (int wy = 0; wy < WINDOW_CHUNKS; ++wy) {
+                for (int wx = 0; wx < WINDOW_CHUNKS; ++wx) storeWindowChunk(wx, wy);
+            }
+        }
+        enemyStore.clear();
+        enemiesOnMap.clear();
+        int heroChunkX = floorDiv(heroX, CHUNK_SIZE), heroChunkY = floorDiv(heroY, CHUNK_SIZE);
+        windowChunkX = heroChunkX - WINDOW_CHUNKS / 2;
+        windowChunkY = heroChunkY - WINDOW_CHUNKS / 2;
+        playerX = heroX - windowChunkX * CHUNK_SIZE;
+        playerY = heroY - windowChunkY * CHUNK_SIZE;
+        for (int wy = 0; wy < WINDOW_CHUNKS; ++wy) {
+            for (int wx = 0; wx < WINDOW_CHUNKS; ++wx) loadWindowChunk(wx, wy);
+        }
+        windowBuilt = true;
+        // Ask for one ring beyond the window so chunks are usually ready before the hero gets there.
+        int reach = WINDOW_CHUNKS / 2 + 1;
+        for (int dy = -reach; dy <= reach; ++dy) {
+            for (int dx = -reach; dx <= reach; ++dx) world->request(heroChunkX + dx, heroChunkY + dy);
+        }
+        world->trim(heroChunkX, heroChunkY, reach);
+    }
+
+    void showMessage(const char* text) {
+        std::copy(messages + 1, messages + MESSAGE_LINES, messages);
+        messages[MESSAGE_LINES - 1] = text;
+    }
+
+    int viewWidth() const { return std::min(gameMap.getWidth(), VIEW_WIDTH); }
+    int viewHeight() const { return std::min(gameMap.getHeight(), VIEW_HEIGHT); }
+
+    void drawExplorationFrame() {
+        int originX = std::clamp(playerX - viewWidth() / 2, 0, gameMap.getWidth() - viewWidth());
+        int originY = std::clamp(playerY - viewHeight() / 2, 0, gameMap.getHeight() - viewHeight());
+        renderer.clear();
+        char line[96];
+        std::snprintf(line, sizeof(line), "You are at (%d, %d). Use WASD to move. Press 'q' to quit.", heroWorldX(), heroWorldY());
+        renderer.drawText(0, 0, line);
+        std::snprintf(line, sizeof(line), "HP: %d", player->getHealth());
+        renderer.drawText(0, 1, line);
+        if (options.fog) sight.update(gameMap, playerX, playerY);
+        renderer.drawMap(gameMap, 0, 2, originX, originY, viewWidth(), viewHeight(), options.fog ? &sight : nullptr);
+        int messageRow = 2 + viewHeight() + 1;
+        for (int i = 0; i < MESSAGE_LINES; ++i) {
+            if (messages[i]) renderer.drawText(0, messageRow + i, messages[i]);
+        }
+        renderer.drawText(0, messageRow + MESSAGE_LINES, "Move: ");
+        renderer.setCursor(6, messageRow + MESSAGE_LINES);
+        renderer.present();
+    }
+
+public:
+    // `source` defaults to the terminal and `screen` to stdout; both must outlive the GameManager.
+    GameManager(const GameOptions& gameOptions = GameOptions(), InputSource* source = nullptr, TextSink* screen = nullptr)
+        : options(gameOptions), input(source ? source : &terminalInput), running(true), quit(false),
+          rngService(gameOptions.seed ? gameOptions.seed : RngService::seedFromClock()),
+          spawnRng(rngService.stream(RngService::SPAWN)), combatRng(rngService.stream(RngService::COMBAT)),
+          combatObserver(nullptr),
+          movesProcessed(0), combatRounds(0),
+          enemyStore(arena.resource()), enemiesOnMap(arena.resource()),
+          gameMap(initialMapSize(gameOptions, gameOptions.mapWidth), initialMapSize(gameOptions, gameOptions.mapHeight)),
+          playerX(2), playerY(2),
+          renderer(80, std::max(std::min(gameOptions.worldDir.empty() ? std::max(gameOptions.mapHeight, 5) : VIEW_HEIGHT, VIEW_HEIGHT) + 4 + MESSAGE_LINES, 10),
+                   gameOptions.headless),
+          flowField(gameOptions.huntRadius), pathFinder(arena.resource()),
+          hunters(arena.resource()), huntersByDistance(arena.resource()), distanceCounts(arena.resource()),
+          sight(gameOptions.sightRadius) {
+        if (!options.worldDir.empty()) {
+            world = std::make_unique<ChunkedWorld>(rngService.stream(RngService::WORLD).next(), options.worldDir, options.worldCache);
+        }
+        enemiesOnMap.reset(gameMap.getWidth(), gameMap.getHeight());
+        renderer.setSink(screen);
+        logMessage<MessageLog::NOTICE>("Welcome to Ankr\n");
+    }
+
+    int heroWorldX() const { return windowChunkX * CHUNK_SIZE + playerX; }
+    int heroWorldY() const { return windowChunkY * CHUNK_SIZE + playerY; }
+
+    // Takes in chunks the worker has finished and re-centres the window once the hero leaves
+    // its middle chunk. Never waits for the worker.
+    void streamWorld() {
+        if (!world) return;
+        world->poll(arrivedChunks);
+        for (int64_t key : arrivedChunks) {
+            int wx = ChunkedWorld::chunkX(key) - windowChunkX, wy = ChunkedWorld::chunkY(key) - windowChunkY;
+            if (wx >= 0 && wx < WINDOW_CHUNKS && wy >= 0 && wy < WINDOW_CHUNKS) loadWindowChunk(wx, wy);
+        }
+        if (floorDiv(playerX, CHUNK_SIZE) != WINDOW_CHUNKS / 2 || floorDiv(playerY, CHUNK_SIZE) != WINDOW_CHUNKS / 2) {
+            rebuildWindow(heroWorldX(), heroWorldY());
+        }
+    }
+
+    ChunkedWorld* getWorld() { return world.get(); }
+    int getPlayerX() const { return playerX; }
+    int getPlayerY() const { return playerY; }
+
+    // enemiesOnMap is the only record of where enemies are; these keep enemyStore and the
+    // ENEMY tiles in step with it.
+    bool placeEnemy(int x, int y, EnemyKind kind) {
+        if (gameMap.getTile(x, y) != TileType::EMPTY) return false;
+        enemiesOnMap.insertUnique(x, y, enemyStore.create(kind, x, y));
+        gameMap.setTileUnchecked(x, y, TileType::ENEMY);
+        if (EventJournal* journal = EventJournal::current()) journal->spawn(x, y, static_cast<int>(kind));
+        return true;
+    }
+
+    void removeEnemy(int x, int y) {
+        EntityId* id = enemiesOnMap.find(x, y);
+        if (!id) return;
+        enemyStore.destroy(*id);
+        enemiesOnMap.erase(x, y);
+        gameMap.setTile(x, y, TileType::EMPTY);
+    }
+
+    bool moveEnemy(int fromX, int fromY, int toX, int toY) {
+        if (gameMap.getTile(toX, toY) != TileType::EMPTY) return false;
+        EntityId* id = enemiesOnMap.find(fromX, fromY);
+        if (!id) return false;
+        enemyStore.setPosition(*id, toX, toY);
+        enemiesOnMap.move(fromX, fromY, toX, toY);
+        gameMap.setTile(fromX, fromY, TileType::EMPTY);
+        gameMap.setTile(toX, toY, TileType::ENEMY);
+        return true;
+    }
+
+    // One pass over every enemy per exploration step, then the hunters close in and, with
+    // `roam` set, everyone else wanders.
+    void tickEnemies(bool allowCombat = true) {
+        removeSlainEnemies();
+        enemyStore.advance();
+        if (!running) return;
+        updateInterest();
+        if (options.huntRadius > 0 && huntHero(allowCombat)) return;
+        if (options.roam) roamEnemies();
+    }
+
+    // Only the regions within the interest radius of the hero are simulated; the rest stay as
+    // they are until the hero comes back. Enemies in an active region have their regeneration
+    // brought up to date, so anything the tick reads or writes about them is current.
+    void updateInterest() {
+        activeRegions.clear();
+        int regions = enemiesOnMap.regionCount();
+        if (options.interestRadius <= 0 || regions == 1) {
+            for (int r = 0; r < regions; ++r) activeRegions.push_back(r);
+            enemyStore.settleAll();
+            return;
+        }
+        // Hunting and sight must never reach into a frozen region.
+        int reach = std::max({ options.interestRadius, options.huntRadius, options.sightRadius }) + 1;
+        int x0 = std::max(playerX - reach, 0), x1 = std::min(playerX + reach, gameMap.getWidth() - 1);
+        int y0 = std::max(playerY - reach, 0), y1 = std::min(playerY + reach, gameMap.getHeight() - 1);
+        int columns = enemiesOnMap.regionColumns();
+        int first = enemiesOnMap.regionOf(x0, y0), last = enemiesOnMap.regionOf(x1, y1);
+        for (int row = first / columns; row <= last / columns; ++row) {
+            for (int column = first % columns; column <= last % columns; ++column) {
+                int r = row * columns + column;
+                activeRegions.push_back(r);
+                for (const auto& entry : enemiesOnMap.region(r)) enemyStore.settle(entry.value);
+            }
+        }
+    }
+
+    // Every enemy near the hero takes a step along the shared flow field, nearest first so
+    // the ones behind can follow. An enemy that reaches the hero starts a fight, unless
+    // `allowCombat` is false because the hero has just been in one; true if a fight started.
+    bool huntHero(bool allowCombat) {
+        flowField.update(gameMap, playerX, playerY);
+
+        hunters.clear();
+        int side = flowField.getSide();
+        // The ENEMY tiles say where the hunters are without probing the spatial index per cell.
+        int left = std::max(flowField.getOriginX(), 0), top = std::max(flowField.getOriginY(), 0);
+        int right = std::min(flowField.getOriginX() + side, gameMap.getWidth());
+        int bottom = std::min(flowField.getOriginY() + side, gameMap.getHeight());
+        for (int y = top; y < bottom; ++y) {
+            for (int x = left; x < right; ++x) {
+                if (gameMap.getTileUnchecked(x, y) == TileType::ENEMY) hunters.push_back(Hunter{x, y, flowField.distanceAt(x, y)});
+            }
+        }
+        if (hunters.empty()) return false;
+
+        // Counting sort by distance; enemies the field cannot reach go last.
+        size_t buckets = size_t(side) * side + 1;
+        distanceCounts.assign(buckets + 1, 0);
+        for (const Hunter& h : hunters) ++distanceCounts[std::min<size_t>(h.dist, buckets - 1) + 1];
+        for (size_t i = 1; i <= buckets; ++i) distanceCounts[i] += distanceCounts[i - 1];
+        huntersByDistance.resize(hunters.size());
+        for (const Hunter& h : hunters) huntersByDistance[distanceCounts[std::min<size_t>(h.dist, buckets - 1)]++] = h;
+        Profiler::count(Profiler::ENEMIES_PROCESSED, huntersByDistance.size());
+
+        // Enemies walled off inside the window share a fixed A* budget per tick, so the tick
+        // costs one window update plus one step per hunter however many are stuck.
+        size_t searchBudget = SEARCH_NODES_PER_TICK;
+        for (const Hunter& h : huntersByDistance) {
+            int nx, ny;
+            if (!flowField.stepToward(h.x, h.y, nx, ny)) {
+                if (h.dist != FlowField::UNREACHED || searchBudget == 0) continue;
+                bool found = pathFinder.findPath(gameMap, h.x, h.y, playerX, playerY, path, searchBudget);
+                searchBudget -= std::min(searchBudget, pathFinder.lastExpanded());
+                if (!found) continue;
+                nx = path.front().first;
+                ny = path.front().second;
+            }
+            if (nx == playerX && ny == playerY) {
+                if (!allowCombat) continue;
+                showMessage("An enemy attacks you!");
+                startCombat(h.x, h.y);
+                return true;
+            }
+            moveEnemy(h.x, h.y, nx, ny);
+        }
+        return false;
+    }
+
+    // Runs fn(region) for every region in `regions`, spread over the tick threads.
+    template <typename Fn>
+    void forEachRegion(const std::vector<int>& regions, Fn&& fn) {
+        if (regions.size() == 1 || options.tickThreads <= 1) {
+            for (int r : regions) fn(size_t(r));
+            return;
+        }
+        if (!tickPool) tickPool = std::make_unique<WorkStealingPool>(unsigned(options.tickThreads));
+        tickPool->run(regions.size(), [&](size_t i) { fn(size_t(regions[i])); });
+    }
+
+    // The region next to `r` in direction `dir` (as numbered in RoamRegion), or -1 off the map.
+    int neighbourRegion(int r, int dir) const {
+        int columns = enemiesOnMap.regionColumns(), rows = enemiesOnMap.regionRows();
+        int rx = r % columns, ry = r / columns;
+        switch (dir) {
+            case 1: return ry > 0 ? r - columns : -1;
+            case 2: return ry + 1 < rows ? r + columns : -1;
+            case 3: return rx > 0 ? r - 1 : -1;
+            case 4: return rx + 1 < columns ? r + 1 : -1;
+            default: return r;
+        }
+    }
+
+    // Which of `r`'s buckets a move to or from region `other`, `r` itself or a neighbour, goes in.
+    int directionOf(int r, int other) const {
+        int columns = enemiesOnMap.regionColumns();
+        if (other == r) return 0;
+        if (other == r - columns) return 1;
+        if (other == r + columns) return 2;
+        return other < r ? 3 : 4;
+    }
+
+    static int oppositeDirection(int dir) {
+        return dir == 0 ? 0 : dir % 2 ? dir + 1 : dir - 1;
+    }
+
+    // Regions that sat out some roaming ticks catch up in one coarse step: each enemy jumps to
+    // where a random walk that long might have taken it, if that tile is EMPTY and in the same
+    // region, and otherwise stays put.
+    void catchUpRoaming(int r, uint64_t ticks, uint64_t seed) {
+        int columns = enemiesOnMap.regionColumns(), size = RegionIndex<EntityId>::REGION_SIZE;
+        int x0 = r % columns * size, y0 = r / columns * size;
+        int x1 = std::min(x0 + size, gameMap.getWidth()), y1 = std::min(y0 + size, gameMap.getHeight());
+        // A step is taken half the time, along one axis, so each axis has variance ticks / 4;
+        // a sum of two uniforms on [-1, 1] has variance 1 / 6.
+        double spread = std::sqrt(1.5 * double(ticks)) / 2;
+        SpatialIndex<EntityId>& shard = enemiesOnMap.region(r);
+        for (auto& entry : shard) {
+            int x = entry.x, y = entry.y;
+            uint64_t roll = RngService::mix(seed ^ (uint64_t(uint32_t(x)) << 32 | uint32_t(y)));
+            double dx = double(roll & 0xFFFF) / 0xFFFF + double(roll >> 16 & 0xFFFF) / 0xFFFF - 1;
+            double dy = double(roll >> 32 & 0xFFFF) / 0xFFFF + double(roll >> 48) / 0xFFFF - 1;
+            int toX = std::clamp(x + int(std::lround(dx * spread)), x0, x1 - 1);
+            int toY = std::clamp(y + int(std::lround(dy * spread)), y0, y1 - 1);
+            if (gameMap.getTileUnchecked(toX, toY) != TileType::EMPTY) continue;
+            // move() keeps the entry where it is, so the walk over the shard is not disturbed.
+            shard.move(x, y, toX, toY);
+            enemyStore.setPosition(entry.value, toX, toY);
+            gameMap.setTileUnchecked(x, y, TileType::EMPTY);
+            gameMap.setTileUnchecked(toX, toY, TileType::ENEMY);
+        }
+    }
+
+    // Every enemy outside the hunt window in an active region picks a direction from a hash of
+    // the seed, the tick and its cell, so the choice does not depend on which thread looks at
+    // it, and steps there if the tile was EMPTY when the pass began. Each region only writes
+    // its own tiles and index shard:
+    //   1. each active region lists its enemies' claims, bucketed by the region they lead into;
+    //   2. each region they lead into collects the claims on its cells, gives each cell to the
+    //      claim from the lowest source cell and places the winners;
+    //   3. each active region takes the winners that left it off their old cells.
+    // The result is the same for any number of tick threads.
+    void roamEnemies() {
+        int regions = enemiesOnMap.regionCount();
+        uint64_t tick = roamTicks++;
+        if (roamRegions.size() != size_t(regions)) {
+            roamRegions.resize(size_t(regions));
+            for (RoamRegion& region : roamRegions) region.roamedTo = tick;
+        }
+        uint64_t tickSeed = RngService::mix(rngService.streamSeed(RngService::ROAM) ^ tick);
+        bool hunting = options.huntRadius > 0;
+        int side = flowField.getSide(), left = flowField.getOriginX(), top = flowField.getOriginY();
+        gameMap.disableFreeCellIndex();
+
+        roamTargets.clear();
+        for (int r : activeRegions) {
+            RoamRegion& region = roamRegions[size_t(r)];
+            if (region.roamedTo < tick) catchUpRoaming(r, tick - region.roamedTo, RngService::mix(tickSeed + 1));
+            region.roamedTo = tick + 1;
+            for (int dir = 0; dir < 5; ++dir) {
+                int target = neighbourRegion(r, dir);
+                if (target < 0 || roamRegions[size_t(target)].listedAt == tick) continue;
+                roamRegions[size_t(target)].listedAt = tick;
+                roamTargets.push_back(target);
+            }
+        }
+
+        forEachRegion(activeRegions, [&](size_t r) {
+            static constexpr int STEP_X[4] = { 0, 0, -1, 1 };
+            static constexpr int STEP_Y[4] = { -1, 1, 0, 0 };
+            RoamRegion& region = roamRegions[r];
+            for (auto& claims : region.claims) claims.clear();
+            region.claimedAt = tick;
+            region.roamers = 0;
+            for (const auto& entry : enemiesOnMap.region(int(r))) {
+                int x = entry.x, y = entry.y;
+                if (hunting && x >= left && x < left + side && y >= top && y < top + side) continue;
+                ++region.roamers;
+                int dir = int(RngService::mix(tickSeed ^ (uint64_t(uint32_t(x)) << 32 | uint32_t(y))) & 7);
+                if (dir >= 4) continue;
+                int toX = x + STEP_X[dir], toY = y + STEP_Y[dir];
+                if (gameMap.getTile(toX, toY) != TileType::EMPTY) continue;
+                int bucket = directionOf(int(r), enemiesOnMap.regionOf(toX, toY));
+                region.claims[bucket].push_back(RoamMove{x, y, toX, toY, entry.value});
+            }
+        });
+
+        // Claims left over from a tick when a region was last active are not for this one.
+        auto claimsOn = [&](int r, int dir) -> const std::vector<RoamMove>* {
+            int from = neighbourRegion(r, dir);
+            if (from < 0 || roamRegions[size_t(from)].claimedAt != tick) return nullptr;
+            return &roamRegions[size_t(from)].claims[oppositeDirection(dir)];
+        };
+
+        // The shards allocate from the level arena, which is not thread safe, so they grow here.
+        for (int r : roamTargets) {
+            size_t incoming = 0;
+            for (int dir = 0; dir < 5; ++dir) {
+                if (const auto* claims = claimsOn(r, dir)) incoming += claims->size();
+            }
+            SpatialIndex<EntityId>& shard = enemiesOnMap.region(r);
+            if (incoming) shard.reserve(shard.size() + incoming + shard.size() / 2);
+        }
+
+        int64_t width = gameMap.getWidth();
+        forEachRegion(roamTargets, [&](size_t r) {
+            RoamRegion& region = roamRegions[r];
+            region.gathered.clear();
+            for (int dir = 0; dir < 5; ++dir) {
+                if (const auto* claims = claimsOn(int(r), dir)) region.gathered.insert(region.gathered.end(), claims->begin(), claims->end());
+            }
+            std::sort(region.gathered.begin(), region.gathered.end(), [width](const RoamMove& a, const RoamMove& b) {
+                int64_t ta = a.toY * width + a.toX, tb = b.toY * width + b.toX;
+                return ta != tb ? ta < tb : a.fromY * width + a.fromX < b.fromY * width + b.fromX;
+            });
+            for (auto& departures : region.departures) departures.clear();
+            SpatialIndex<EntityId>& shard = enemiesOnMap.region(int(r));
+            for (size_t i = 0; i < region.gathered.size(); ++i) {
+                const RoamMove& move = region.gathered[i];
+                if (i > 0 && region.gathered[i - 1].toX == move.toX && region.gathered[i - 1].toY == move.toY) continue;
+                gameMap.setTileShared(move.toX, move.toY, TileType::ENEMY);
+                shard.insertUnique(move.toX, move.toY, move.id);
+                enemyStore.setPosition(move.id, move.toX, move.toY);
+                region.departures[directionOf(int(r), enemiesOnMap.regionOf(move.fromX, move.fromY))].push_back(move);
+            }
+        });
+
+        // Every region a winner left is active, so its departures were all written above.
+        forEachRegion(activeRegions, [&](size_t r) {
+            SpatialIndex<EntityId>& shard = enemiesOnMap.region(int(r));
+            for (int dir = 0; dir < 5; ++dir) {
+                int to = neighbourRegion(int(r), dir);
+                if (to < 0 || roamRegions[size_t(to)].listedAt != tick) continue;
+                for (const RoamMove& move : roamRegions[size_t(to)].departures[oppositeDirection(dir)]) {
+                    gameMap.setTileShared(move.fromX, move.fromY, TileType::EMPTY);
+                    shard.erase(move.fromX, move.fromY);
+                }
+            }
+        });
+
+        // Each winner was added to one shard and taken off another, so the total is unchanged.
+        size_t roamers = 0, moved = 0;
+        for (int r : activeRegions) roamers += roamRegions[size_t(r)].roamers;
+        for (int r : roamTargets) {
+            for (const auto& departures : roamRegions[size_t(r)].departures) moved += departures.size();
+        }
+        Profiler::count(Profiler::ENEMIES_PROCESSED, roamers);
+        Profiler::count(Profiler::TILES_WRITTEN, moved * 2);
+    }
+
+    const FlowField& getFlowField() const {
+        return flowField;
+    }
+
+    const FieldOfView& getSight() {
+        sight.update(gameMap, playerX, playerY);
+        return sight;
+    }
+
+    // Drops every enemy the hero can see to zero health and returns how many there were,
+    // counting the one being fought if it is in sight.
+    int killVisibleEnemies() {
+        int killed = 0;
+        getSight().forEachVisible(gameMap, TileType::ENEMY, [&](int x, int y) {
+            EntityId* id = enemiesOnMap.find(x, y);
+            if (!id || enemyStore.healthOf(*id) <= 0) return;
+            enemyStore.healthOf(*id) = 0;
+            slainEnemies.emplace_back(x, y);
+            ++killed;
+        });
+        return killed;
+    }
+
+    void removeSlainEnemies() {
+        for (const auto& cell : slainEnemies) {
+            EntityId* id = enemiesOnMap.find(cell.first, cell.second);
+            if (id && enemyStore.healthOf(*id) <= 0) removeEnemy(cell.first, cell.second);
+        }
+        slainEnemies.clear();
+    }
+
+    // Places `count` enemies on distinct EMPTY tiles in one pass. If there are not that many
+    // free tiles it spawns nothing and returns false.
+    bool spawnEnemies(int count) {
+        if (count <= 0) return true;
+        size_t available = gameMap.countOf(TileType::EMPTY);
+        if (gameMap.getTile(playerX, playerY) == TileType::EMPTY) --available;
+        if (size_t(count) > available) {
+            logMessage<MessageLog::NOTICE>("Cannot spawn {} enemies: only {} free tiles.\n", count, available);
+            return false;
+        }
+        // Built on first use so a resumed game does not read every tile page up front.
+        gameMap.enableFreeCellIndex();
+        enemyStore.reserve(enemyStore.size() + count);
+        enemiesOnMap.reserve(enemiesOnMap.size() + count);
+        for (int i = 0; i < count; ++i) {
+            int x = playerX, y = playerY;
+            while (x == playerX && y == playerY) {
+                gameMap.sampleEmptyCell(spawnRng, x, y);
+            }
+            EnemyKind kind = static_cast<EnemyKind>(spawnRng.below(ENEMY_KIND_COUNT));
+            if (count <= 10) {
+                logMessage<MessageLog::DETAIL>("{} has spawned at ({}, {}).\n", nameOf(ENEMY_KINDS[static_cast<int>(kind)].name), x, y);
+            }
+            placeEnemy(x, y, kind);
+        }
+        if (count > 10) logMessage<MessageLog::EVENT>("{} enemies have spawned.\n", count);
+        return true;
+    }
+
+    void chooseCharacter() {
+        logMessage<MessageLog::NOTICE>("Choose your character:\n1. Aether\n2. Synax\n3. Kahray\n4. Yroy\n5. Batley\n");
+        logMessage<MessageLog::NOTICE>("Enter your choice (1-5): ");
+        int choice = input->readInt(1, 5);
+        heroChoice = choice;
+
+        player = makeHero(choice, arena.resource());
+        if (!player) {
+            logMessage<MessageLog::NOTICE>("Invalid choice! Defaulting to Aether.\n");
+            player = makeHero(1, arena.resource());
+        }
+        player->displayInfo();
+    }
+
+    // Asks which of the hero's abilities to use and anything it needs, such as an amount or a
+    // tile. False if the player's answer was not one of the choices.
+    bool promptAbility(Character& enemy, AbilityUse& use) {
+        const AbilitySet& set = player->getAbilities();
+        use = AbilityUse{ set.ids[0], player.get(), &enemy };
+        if (set.count > 1) {
+            if (*set.heading) logMessage<MessageLog::NOTICE>(set.heading);
+            for (int i = 0; i < set.count; ++i) logMessage<MessageLog::NOTICE>("{}- {}\n", i + 1, ABILITIES[set.ids[i]].name);
+            logMessage<MessageLog::NOTICE>(set.prompt);
+            int choice = input->readInt(1, set.count);
+            if (choice < 1 || choice > set.count) {
+                logMessage<MessageLog::NOTICE>("Invalid command!\n");
+                return false;
+            }
+            use.ability = set.ids[choice - 1];
+        }
+        const AbilityDef& def = ABILITIES[use.ability];
+        if (def.amountPrompt) {
+            logMessage<MessageLog::NOTICE>(def.amountPrompt);
+            use.amount = input->readInt(1, def.damage);
+            if (use.amount <= 0) {
+                logMessage<MessageLog::NOTICE>("Invalid amount!\n");
+                return false;
+            }
+        }
+        if (def.targeting == Targeting::TILE) {
+            logMessage<MessageLog::NOTICE>("Where do you want to teleport?\n");
+            logMessage<MessageLog::NOTICE>("Enter X coordinate: ");
+            use.x = input->readInt(1, gameMap.getWidth() - 2);
+            logMessage<MessageLog::NOTICE>("Enter Y coordinate: ");
+            use.y = input->readInt(1, gameMap.getHeight() - 2);
+        }
+        return true;
+    }
+
+    // Enemies with a choice draw it at random, or think ahead when `bossSearch` is set.
+    AbilityUse pickEnemyAbility(Enemy& enemy) {
+        const AbilitySet& set = enemy.getAbilities();
+        int pick = 0;
+        if (set.count > 1 && options.bossSearch > 0) {
+            CombatState state{ { player->getHealth(), player->getMaxHealth() }, { enemy.getHealth(), enemy.getMaxHealth() } };
+            pick = CombatLookahead(player->getAbilities(), set).choose(state, options.bossSearch);
+        } else if (set.count > 1) {
+            pick = combatRng.range(1, set.count) - 1;
+        }
+        return AbilityUse{ set.ids[pick], &enemy, player.get() };
+    }
+
+    void startCombat(int enemyX, int enemyY) {
+        EntityId* id = enemiesOnMap.find(enemyX, enemyY);
+        if (!id) return;
+        enemyStore.settle(*id);
+        Enemy view(enemyStore, *id);
+        Enemy* enemy = &view;
+        int round = 0;
+        while (running && player->isAlive() && enemy->isAlive()) {
+            if (input->exhausted()) {
+                endGame();
+                return;
+            }
+            ++combatRounds;
+            if (combatObserver) combatObserver->onRound(round++, *player, *enemy);
+            if (!options.headless) {
+                Profiler::Stamp drawn = Profiler::now();
+                renderer.invalidate();
+                renderer.clear();
+                renderer.drawText(0, 0, "---- Combat ----");
+                char line[64];
+                std::snprintf(line, sizeof(line), "%.*s HP: %d", int(player->getName().size()), player->getName().data(), player->getHealth());
+                renderer.drawText(0, 1, line);
+                std::snprintf(line, sizeof(line), "%.*s HP: %d", int(enemy->getName().size()), enemy->getName().data(), enemy->getHealth());
+                renderer.drawText(0, 2, line);
+                renderer.drawText(0, 3, "Choose your action:");
+                renderer.drawText(0, 4, "1. Attack");
+                renderer.drawText(0, 5, "2. Use Special Ability");
+                renderer.drawText(0, 6, "3. Heal");
+                renderer.drawText(0, 7, "4. Run Away");
+                renderer.drawText(0, 8, "Enter your choice (1-4): ");
+                renderer.setCursor(25, 8);
+                renderer.present();
+                // Everything printed from here on scrolls below the frame, so the next frame repaints fully.
+                renderer.invalidate();
+                Profiler::record(Profiler::RENDER, drawn);
+            }
+
+            Profiler::Stamp asked = Profiler::now();
+            int action = input->readInt(1, 4);
+            Profiler::record(Profiler::INPUT, asked);
+            Profiler::Stamp acted = Profiler::now();
+
+            if (action == 1) {
+                enemy->takeDamage(20);
+                logMessage<MessageLog::EVENT>("{} attacks {} for 20 damage.\n", player->getName(), enemy->getName());
+            } else if (action == 2) {
+                AbilityUse use;
+                if (promptAbility(*enemy, use)) applyAbility(use, this);
+            } else if (action == 3) {
+                player->heal(15);
+            } else if (action == 4) {
+                logMessage<MessageLog::EVENT>("{} runs away from the combat!\n", player->getName());
+                return;
+            } else {
+                logMessage<MessageLog::NOTICE>("Invalid action! Try again.\n");
+                continue;
+            }
+
+            if (running && enemy->isAlive()) {
+                applyAbility(pickEnemyAbility(*enemy), this);
+            }
+            Profiler::record(Profiler::ROUND, acted);
+            if (!running) return;
+            logMessage<MessageLog::NOTICE>("Press Enter to continue...");
+            input->waitForEnter();
+        }
+        if (!running) return;
+
+        if (!player->isAlive()) {
+            logMessage<MessageLog::EVENT>("{} is dead.\n", player->getName());
+            logMessage<MessageLog::NOTICE>("Game Over!\n");
+            endGame();
+        } else {
+            logMessage<MessageLog::EVENT>("{} is defeated!\n", enemy->getName());
+            removeEnemy(enemyX, enemyY);
+            logMessage<MessageLog::NOTICE>("Press Enter to continue.\n");
+            input->waitForEnter();
+        }
+    }
+
+    // Runs an enemy tick and times it, unless it started a fight.
+    void timedTick(bool allowCombat) {
+        uint64_t roundsBefore = combatRounds;
+        Profiler::Stamp ticked = Profiler::now();
+        tickEnemies(allowCombat);
+        if (combatRounds == roundsBefore) Profiler::record(Profiler::ENEMIES, ticked);
+    }
+
+    // Hands the tile and byte totals gathered since the last call to the profiler.
+    void flushCounters() {
+        Profiler::count(Profiler::TILES_WRITTEN, gameMap.takeTilesWritten());
+        Profiler::count(Profiler::BYTES_RENDERED, renderer.getBytesEmitted() - bytesReported);
+        bytesReported = renderer.getBytesEmitted();
+    }
+
+    void explorationLoop() {
+        renderer.invalidate();
+        bool realTime = options.tickMs > 0;
+        auto tickInterval = std::chrono::milliseconds(options.tickMs);
+        auto nextTick = std::chrono::steady_clock::now() + tickInterval;
+        while (running) {
+            flushCounters();
+            // Keys that arrived together are all handled before the next frame is drawn.
+            if (!options.headless && !input->hasPendingKey()) {
+                Profiler::Stamp drawn = Profiler::now();
+                drawExplorationFrame();
+                Profiler::record(Profiler::RENDER, drawn);
+            }
+            Profiler::Stamp waited = Profiler::now();
+            char key = realTime ? input->readKeyOrTick(nextTick) : input->readKey();
+            Profiler::record(Profiler::INPUT, waited);
+            if (key == InputSource::TICK) {
+                timedTick(true);
+                // A fight blocks the clock; don't make up for the ticks it missed.
+                nextTick = std::max(nextTick + tickInterval, std::chrono::steady_clock::now());
+                continue;
+            }
+            if (key == InputSource::END_OF_INPUT) {
+                endGame();
+                return;
+            }
+            if (++movesProcessed == options.maxMoves) {
+                quit = true;
+                endGame();
+            }
+            Profiler::Stamp moved = Profiler::now();
+            gameMap.setTile(playerX, playerY, TileType::EMPTY);
+            int nextX = playerX;
+            int nextY = playerY;
+            switch (key) {
+                case 'w': case 'W': nextY--; break;
+                case 's': case 'S': nextY++; break;
+                case 'a': case 'A': nextX--; break;
+                case 'd': case 'D': nextX++; break;
+                case 'q': case 'Q':
+                    renderer.invalidate();
+                    gameMap.setTile(playerX, playerY, TileType::HERO);
+                    logMessage<MessageLog::NOTICE>("\nExiting game.\n");
+                    quit = true;
+                    endGame();
+                    return;
+                default:
+                    showMessage("Invalid command!");
+                    gameMap.setTile(playerX, playerY, TileType::HERO);
+                    continue;
+            }
+            TileType nextTile = gameMap.getTile(nextX, nextY);
+            bool fought = nextTile == TileType::ENEMY;
+            if (nextTile == TileType::WALL) {
+                showMessage("You hit the wall!");
+                gameMap.setTile(playerX, playerY, TileType::HERO);
+            } else if (nextTile == TileType::ENEMY) {
+                showMessage("You met an enemy!");
+                startCombat(nextX, nextY);
+                // Running away leaves the enemy where it was, and teleporting mid-fight moves the hero.
+                if (!enemiesOnMap.contains(nextX, nextY)) {
+                    gameMap.setTile(playerX, playerY, TileType::EMPTY);
+                    playerX = nextX;
+                    playerY = nextY;
+                }
+                gameMap.setTile(playerX, playerY, TileType::HERO);
+            } else {
+                playerX = nextX;
+                playerY = nextY;
+                gameMap.setTile(playerX, playerY, TileType::HERO);
+            }
+            // Fights wait on the player, so moves that start one are left out of the timings.
+            if (!fought) Profiler::record(Profiler::MOVE, moved);
+            if (!realTime) timedTick(!fought);
+            streamWorld();
+            if (EventJournal* journal = EventJournal::current()) journal->heroAt(heroWorldX(), heroWorldY());
+            if (options.autosaveMoves && !options.savePath.empty() && movesProcessed % options.autosaveMoves == 0) {
+                saveSnapshot(options.savePath);
+            }
+        }
+    }
+
+    // Writes the game to `path`. Saving again to the file last saved or loaded rewrites only
+    // the tile chunks changed since, plus the header and enemies; any other save writes a new
+    // file and renames it over `path`.
+    bool saveSnapshot(const std::string& path) {
+        // A streamed world already lives on disk, chunk by chunk.
+        if (!player || world) return false;
+        SnapshotHeader header = {};
+        std::copy(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header.magic);
+        header.version = SNAPSHOT_VERSION;
+        header.heroChoice = uint32_t(heroChoice);
+        header.width = gameMap.getWidth();
+        header.height = gameMap.getHeight();
+        header.wordsPerRow = gameMap.getWordsPerRow();
+        header.playerX = playerX;
+        header.playerY = playerY;
+        header.heroHealth = player->getHealth();
+        header.heroMaxHealth = player->getMaxHealth();
+        header.enemyCount = uint32_t(enemyStore.size());
+        header.tileOffset = SNAPSHOT_PAGE;
+        header.tileBytes = gameMap.wordCount() * sizeof(uint64_t);
+        header.enemyOffset = header.tileOffset + (header.tileBytes + SNAPSHOT_PAGE - 1) / SNAPSHOT_PAGE * SNAPSHOT_PAGE;
+        for (int t = 0; t < 4; ++t) header.tileCounts[t] = gameMap.countOf(static_cast<TileType>(t));
+        header.movesProcessed = movesProcessed;
+        spawnRng.getState(header.spawnRng);
+        combatRng.getState(header.combatRng);
+
+        SnapshotHeader existing;
+        bool incremental = path == snapshotPath && readSnapshotHeader(path, existing) &&
+                           existing.width == header.width && existing.height == header.height;
+        std::string target = incremental ? path : path + ".tmp";
+        std::fstream out(target, incremental ? std::ios::in | std::ios::out | std::ios::binary
+                                             : std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        if (!incremental) gameMap.markAllDirty();
+        // The header page is blanked first and the new one written last, each after a sync, so
+        // a save cut short anywhere, even one rewriting the file in place, never loads.
+        std::vector<char> page(SNAPSHOT_PAGE, 0);
+        out.write(page.data(), std::streamsize(page.size()));
+        if (!out.flush() || !syncFile(target)) return false;
+
+        lastSaveChunks = 0;
+        const char* tiles = reinterpret_cast<const char*>(gameMap.words());
+        size_t chunkBytes = Map::CHUNK_WORDS * sizeof(uint64_t);
+        for (size_t c = 0; c < gameMap.chunkCount(); ++c) {
+            if (!gameMap.chunkDirty(c)) continue;
+            size_t begin = c * chunkBytes;
+            out.seekp(std::streamoff(header.tileOffset + begin));
+            out.write(tiles + begin, std::streamsize(std::min<size_t>(chunkBytes, header.tileBytes - begin)));
+            ++lastSaveChunks;
+        }
+
+        std::vector<EnemyRecord> records(enemyStore.size());
+        for (size_t slot = 0; slot < records.size(); ++slot) {
+            EntityId id = enemyStore.idAt(slot);
+            records[slot] = EnemyRecord{enemyStore.xOf(id), enemyStore.yOf(id), enemyStore.currentHealthOf(id),
+                                        enemyStore.maxHealthOf(id), uint32_t(enemyStore.kindOf(id))};
+        }
+        out.seekp(std::streamoff(header.enemyOffset));
+        out.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(EnemyRecord)));
+        if (!out.flush()) return false;
+        // Writing no records leaves the file short of enemyOffset; a shorter enemy list would
+        // leave stale records past its end. Either way the file is cut to its exact size.
+        std::error_code error;
+        std::filesystem::resize_file(target, header.enemyOffset + records.size() * sizeof(EnemyRecord), error);
+        if (error || !syncFile(target)) return false;
+        std::copy(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header), page.begin());
+        out.seekp(0);
+        out.write(page.data(), std::streamsize(page.size()));
+        out.close();
+        if (!out || !syncFile(target)) return false;
+        if (!incremental && std::rename(target.c_str(), path.c_str()) != 0) return false;
+
+        gameMap.clearDirty();
+        snapshotPath = path;
+        return true;
+    }
+
+    // Maps the tile block of a snapshot in place and rebuilds the enemies from their records.
+    // Everything the file says is checked before the game is touched, so a damaged snapshot
+    // is refused rather than trusted.
+    bool loadSnapshot(const std::string& path) {
+        std::unique_ptr<MappedFile> file = MappedFile::open(path);
+        if (!file || file->size() < sizeof(SnapshotHeader)) return false;
+        SnapshotHeader header;
+        std::copy(file->data(), file->data() + sizeof(header), reinterpret_cast<char*>(&header));
+        if (!std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header.magic) || header.version != SNAPSHOT_VERSION) return false;
+        // Offsets and lengths come from the file, so each is checked against the room left after
+        // the one before rather than added up, which could wrap.
+        uint64_t size = file->size();
+        if (header.width < 5 || header.height < 5 ||
+            header.wordsPerRow != (int64_t(header.width) + Map::TILES_PER_WORD - 1) / Map::TILES_PER_WORD ||
+            header.tileBytes != uint64_t(header.wordsPerRow) * uint64_t(header.height) * sizeof(uint64_t) ||
+            header.tileOffset % SNAPSHOT_PAGE != 0 || header.tileOffset > size || header.tileBytes > size - header.tileOffset ||
+            header.enemyOffset > size || header.enemyCount > (size - header.enemyOffset) / sizeof(EnemyRecord)) {
+            return false;
+        }
+
+        std::vector<EnemyRecord> records(header.enemyCount);
+        std::copy(file->data() + header.enemyOffset,
+                  file->data() + header.enemyOffset + records.size() * sizeof(EnemyRecord),
+                  reinterpret_cast<char*>(records.data()));
+        Map loaded(header.width, header.height, std::move(file), size_t(header.tileOffset), header.tileCounts);
+        if (!loaded.tilesConsistent()) return false;
+
+        auto inside = [&](int x, int y) { return x >= 0 && x < header.width && y >= 0 && y < header.height; };
+        if (!inside(header.playerX, header.playerY) || header.heroHealth <= 0 || header.heroHealth > header.heroMaxHealth) return false;
+        TileType heroTile = loaded.getTileUnchecked(header.playerX, header.playerY);
+        if (heroTile == TileType::WALL || heroTile == TileType::ENEMY) return false;
+        std::vector<int64_t> cells;
+        cells.reserve(records.size());
+        for (const EnemyRecord& record : records) {
+            if (record.kind >= ENEMY_KIND_COUNT || !inside(record.x, record.y) || record.health <= 0 ||
+                record.health > record.maxHealth || loaded.getTileUnchecked(record.x, record.y) != TileType::ENEMY) {
+                return false;
+            }
+            cells.push_back(int64_t(record.y) * header.width + record.x);
+        }
+        std::sort(cells.begin(), cells.end());
+        if (std::adjacent_find(cells.begin(), cells.end()) != cells.end()) return false;
+        gameMap = std::move(loaded);
+
+        enemyStore.clear();
+        enemiesOnMap.reset(gameMap.getWidth(), gameMap.getHeight());
+        enemyStore.reserve(records.size());
+        enemiesOnMap.reserve(records.size());
+        for (const EnemyRecord& record : records) {
+            EntityId id = enemyStore.create(static_cast<EnemyKind>(record.kind), record.x, record.y);
+            enemyStore.healthOf(id) = record.health;
+            enemyStore.maxHealthOf(id) = record.maxHealth;
+            enemiesOnMap.insertUnique(record.x, record.y, id);
+        }
+
+        heroChoice = int(header.heroChoice);
+        player = makeHero(heroChoice, arena.resource());
+        if (!player) player = makeHero(heroChoice = 1, arena.resource());
+        player->restoreHealth(header.heroHealth, header.heroMaxHealth);
+        playerX = header.playerX;
+        playerY = header.playerY;
+        movesProcessed = header.movesProcessed;
+        spawnRng.setState(header.spawnRng);
+        combatRng.setState(header.combatRng);
+        snapshotPath = path;
+        return true;
+    }
+
+    size_t getLastSaveChunks() const { return lastSaveChunks; }
+
+    // FNV-1a over the tiles, the hero and every enemy; equal hashes mean equal games.
+    uint64_t stateHash() const {
+        uint64_t hash = 14695981039346656037ULL;
+        auto mixIn = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ULL; };
+        for (size_t i = 0; i < gameMap.wordCount(); ++i) mixIn(gameMap.words()[i]);
+        mixIn(uint64_t(heroWorldX()));
+        mixIn(uint64_t(heroWorldY()));
+        mixIn(player ? uint64_t(player->getHealth()) : 0);
+        mixIn(movesProcessed);
+        enemiesOnMap.forEach([&](int x, int y, EntityId id) {
+            mixIn(uint64_t(x) << 32 | uint32_t(y));
+            mixIn(uint64_t(enemyStore.currentHealthOf(id)));
+        });
+        return hash;
+    }
+
+    void runGame() {
+        if (EventJournal* journal = EventJournal::current()) journal->gameStart(rngService.getMasterSeed());
+        if (!world && !options.loadPath.empty() && loadSnapshot(options.loadPath)) {
+            logMessage<MessageLog::NOTICE>("Resumed {} at ({}, {}) from {}.\n", player->getName(), playerX, playerY, options.loadPath);
+        } else {
+            if (!options.loadPath.empty()) {
+                logMessage<MessageLog::NOTICE>("Cannot load {}; starting a new game.\n", options.loadPath);
+                // Headless runs show no game text, and a script resuming a save needs to know.
+                if (options.headless) std::cerr << "Cannot load " << options.loadPath << "; starting a new game." << std::endl;
+                gameMap = Map(std::max(options.mapWidth, Map::MIN_SIDE), std::max(options.mapHeight, Map::MIN_SIDE));
+                enemiesOnMap.reset(gameMap.getWidth(), gameMap.getHeight());
+            }
+            chooseCharacter();
+            logMessage<MessageLog::NOTICE>("\nPress Enter to start the game...");
+            input->waitForEnter();
+            if (world) {
+                // The only wait on the world: the chunks under the first window.
+                for (int cy = -1; cy <= 1; ++cy) {
+                    for (int cx = -1; cx <= 1; ++cx) world->waitFor(cx, cy);
+                }
+                rebuildWindow(CHUNK_SIZE / 2, CHUNK_SIZE / 2);
+                if (enemiesOnMap.contains(playerX, playerY)) removeEnemy(playerX, playerY);
+                gameMap.setTile(playerX, playerY, TileType::HERO);
+            } else {
+                gameMap.setTile(playerX, playerY, TileType::HERO);
+                spawnEnemies(options.enemyCount);
+            }
+        }
+        explorationLoop();
+        flushCounters();
+        if (EventJournal* journal = EventJournal::current()) journal->gameEnd(stateHash());
+        if (world) {
+            removeSlainEnemies();
+            for (int wy = 0; wy < WINDOW_CHUNKS; ++wy) {
+                for (int wx = 0; wx < WINDOW_CHUNKS; ++wx) storeWindowChunk(wx, wy);
+            }
+            world->flush();
+        }
+        if (!options.savePath.empty() && player->isAlive()) {
+            if (saveSnapshot(options.savePath)) {
+                logMessage<MessageLog::NOTICE>("Saved to {}.\n", options.savePath);
+            } else {
+                logMessage<MessageLog::NOTICE>("Could not save to {}.\n", options.savePath);
+            }
+        }
+    }
+
+    Map& getMap() {
+        return gameMap;
+    }
+
+    EnemyStore& getEnemies() {
+        return enemyStore;
+    }
+
+    InputSource& getInput() {
+        return *input;
+    }
+
+    // Stops the game loops after the current action instead of exiting the process.
+    void endGame() {
+        running = false;
+    }
+
+    void setPlayer(ArenaPtr<Character> hero) {
+        player = std::move(hero);
+    }
+
+    LevelArena& getArena() {
+        return arena;
+    }
+
+    Character& getPlayer() {
+        return *player;
+    }
+
+    Rng& getRng() {
+        return combatRng;
+    }
+
+    RngService& getRngService() {
+        return rngService;
+    }
+
+    void setCombatObserver(CombatObserver* observer) {
+        combatObserver = observer;
+    }
+
+    bool isRunning() const { return running; }
+    bool quitRequested() const { return quit; }
+    uint64_t getMovesProcessed() const { return movesProcessed; }
+    uint64_t getCombatRounds() const { return combatRounds; }
+
+    void setPlayerPosition(int x, int y) {
+        gameMap.setTile(playerX, playerY, TileType::EMPTY);
+        playerX = x;
+        playerY = y;
+        gameMap.setTile(playerX, playerY, TileType::HERO);
+    }
+};
@@ -0,0 +1,27 @@
+#include "ankr.h"
+
+void EffectHandler<EffectKind::KILL>::apply(const AbilityDef& def, const AbilityUse& use, GameManager* game) {
+    if (use.target->isAlive()) {
+        logMessage<MessageLog::EVENT>(def.message, use.target->getName());
+        use.target->setHealth();
+    }
+    if (!game || def.targeting != Targeting::ENEMIES_IN_SIGHT) return;
+    int others = game->killVisibleEnemies();
+    if (others > 0) logMessage<MessageLog::EVENT>("{} other enemies in sight fall with it.\n", others);
+}
+
+void EffectHandler<EffectKind::END_GAME>::apply(const AbilityDef& def, const AbilityUse& use, GameManager* game) {
+    if (def.message) logMessage<MessageLog::EVENT>(def.message, use.user->getName());
+    if (game) game->endGame();
+}
+
+void EffectHandler<EffectKind::TELEPORT>::apply(const AbilityDef& def, const AbilityUse& use, GameManager* game) {
+    if (!game) return;
+    Map& map = game->getMap();
+    if (use.x > 0 && use.x < map.getWidth() - 1 && use.y > 0 && use.y < map.getHeight() - 1 && map.getTile(use.x, use.y) == TileType::EMPTY) {
+        game->setPlayerPosition(use.x, use.y);
+        logMessage<MessageLog::EVENT>(def.message, use.user->getName(), use.x, use.y);
+    } else {
+        logMessage<MessageLog::NOTICE>("Cannot teleport to ({}, {}). Tile is not empty or out of bounds.\n", use.x, use.y);
+    }
+}
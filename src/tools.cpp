@@ -0,0 +1,1196 @@
+#include "tools.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <ucontext.h>
+#endif
+
+void runCombatSimulation(uint64_t trialsPerPairing, unsigned threads, uint64_t seed, uint64_t bossSearch) {
+    std::cout << "Simulating " << trialsPerPairing << " duels per pairing on " << threads
+              << " threads (seed " << seed << ")";
+    if (bossSearch) std::cout << ", enemies searching " << bossSearch << " turns ahead";
+    std::cout << std::endl;
+    std::vector<DuelStats> results;
+    auto begin = std::chrono::steady_clock::now();
+    {
+        CombatSimulator simulator(seed, threads, bossSearch);
+        // Duels post game text like the real game; keep that quiet while they run.
+        MessageLog::setVerbosity(MessageLog::SILENT);
+        results = simulator.run(trialsPerPairing);
+        MessageLog::setVerbosity(MessageLog::DETAIL);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-8s %-9s %7s %7s %7s %7s %9s %4s %4s  %s\n",
+                  "hero", "enemy", "win%", "loss%", "ended%", "fled%", "avgTurns", "p50", "p99", "hero HP by round");
+    std::cout << line;
+    uint64_t total = 0;
+    for (size_t p = 0; p < results.size(); ++p) {
+        const DuelStats& s = results[p];
+        total += s.trials;
+        ArenaPtr<Character> hero = makeHero(int(p) / ENEMY_KIND_COUNT + 1);
+        double n = double(std::max<uint64_t>(s.trials, 1));
+        std::string_view heroName = hero->getName(), enemyName = nameOf(ENEMY_KINDS[p % ENEMY_KIND_COUNT].name);
+        std::snprintf(line, sizeof(line), "%-8.*s %-9.*s %7.2f %7.2f %7.2f %7.2f %9.2f %4llu %4llu  ",
+                      int(heroName.size()), heroName.data(), int(enemyName.size()), enemyName.data(),
+                      100.0 * s.heroWins / n, 100.0 * s.enemyWins / n, 100.0 * s.gameEnded / n, 100.0 * s.timeouts / n,
+                      s.heroWins ? double(s.totalWinTurns) / s.heroWins : 0.0,
+                      (unsigned long long)s.winTurnPercentile(0.5), (unsigned long long)s.winTurnPercentile(0.99));
+        std::cout << line;
+        for (int r = 0; r < 6 && s.curveCount[r]; ++r) {
+            std::cout << (r ? " " : "") << s.curveSum[r] / s.curveCount[r];
+        }
+        std::cout << "\n";
+    }
+    std::cout << total << " duels in " << seconds << " s (" << total / std::max(seconds, 1e-9) << " duels/s)" << std::endl;
+}
+
+// The pre-packing layout, kept only so --bench-map has something to compare against.
+struct LegacyGrid {
+    enum class Cell { EMPTY = 0, WALL, HERO, ENEMY };
+    int width;
+    int height;
+    std::vector<std::vector<Cell>> grid;
+
+    LegacyGrid(int w, int h) : width(w), height(h) {
+        grid.resize(height, std::vector<Cell>(width, Cell::EMPTY));
+    }
+
+    Cell getTile(int x, int y) const {
+        if (y >= 0 && y < height && x >= 0 && x < width) {
+            return grid[y][x];
+        }
+        return Cell::WALL;
+    }
+
+    size_t memoryBytes() const {
+        return sizeof(grid) + size_t(height) * (sizeof(std::vector<Cell>) + size_t(width) * sizeof(Cell));
+    }
+};
+
+void runMapBenchmark(int size) {
+    const int lookups = 20000000;
+    std::vector<std::pair<int, int>> coords(1 << 16);
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (auto& c : coords) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        c.first = 1 + int((state >> 33) % uint64_t(size - 2));
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        c.second = 1 + int((state >> 33) % uint64_t(size - 2));
+    }
+
+    auto timeLookups = [&](auto&& lookup) {
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t checksum = 0;
+        for (int i = 0; i < lookups; ++i) {
+            const auto& c = coords[i & (coords.size() - 1)];
+            checksum += lookup(c.first, c.second);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        return std::make_pair(ns / lookups, checksum);
+    };
+
+    std::cout << "Map benchmark: " << size << " x " << size << " tiles, " << lookups << " random lookups" << std::endl;
+    {
+        LegacyGrid legacy(size, size);
+        for (const auto& c : coords) legacy.grid[c.second][c.first] = LegacyGrid::Cell::ENEMY;
+        auto result = timeLookups([&](int x, int y) { return int(legacy.getTile(x, y)); });
+        std::cout << "  nested vectors:  " << legacy.memoryBytes() / (1024 * 1024) << " MiB, "
+                  << result.first << " ns/getTile (checksum " << result.second << ")" << std::endl;
+    }
+    {
+        Map packed(size, size);
+        for (const auto& c : coords) packed.setTile(c.first, c.second, TileType::ENEMY);
+        auto checked = timeLookups([&](int x, int y) { return int(packed.getTile(x, y)); });
+        auto unchecked = timeLookups([&](int x, int y) { return int(packed.getTileUnchecked(x, y)); });
+        std::cout << "  packed 2-bit:    " << packed.memoryBytes() / (1024 * 1024) << " MiB, "
+                  << checked.first << " ns/getTile, " << unchecked.first << " ns/getTileUnchecked (checksum "
+                  << checked.second << "/" << unchecked.second << ")" << std::endl;
+
+        auto begin = std::chrono::steady_clock::now();
+        size_t enemies = packed.countTiles(TileType::ENEMY);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "  countTiles(ENEMY) = " << enemies << " in " << ms << " ms" << std::endl;
+    }
+}
+
+void runRenderBenchmark(int frames) {
+    Map map(38, 18);
+    for (int x = 6; x < 32; x += 5) map.fillRect(x, 4, x + 1, 14, TileType::WALL);
+    TerminalRenderer renderer(80, 23, true);
+    size_t legacyBytes = 0;
+    int heroX = 1, heroY = 1, dx = 1;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        map.setTile(heroX, heroY, TileType::EMPTY);
+        int nextX = heroX + dx;
+        if (map.getTile(nextX, heroY) != TileType::EMPTY) {
+            dx = -dx;
+            heroY = heroY % (map.getHeight() - 2) + 1;
+        } else {
+            heroX = nextX;
+        }
+        map.setTile(heroX, heroY, TileType::HERO);
+
+        std::string status = "You are at (" + std::to_string(heroX) + ", " + std::to_string(heroY) + "). Use WASD to move. Press 'q' to quit.";
+        renderer.clear();
+        renderer.drawText(0, 0, status);
+        renderer.drawText(0, 1, "HP: 65");
+        renderer.drawMap(map, 0, 2, 0, 0, map.getWidth(), map.getHeight());
+        renderer.drawText(0, 22, "Move: ");
+        renderer.setCursor(6, 22);
+        renderer.present();
+
+        // What system("clear") + Map::display used to send for the same frame.
+        legacyBytes += 10 + status.size() + 1 + 7 + size_t(map.getWidth() * 2 + 1) * map.getHeight() + 2 + 6;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Render benchmark: " << frames << " frames" << std::endl;
+    std::cout << "  diff renderer: " << renderer.getBytesEmitted() << " bytes ("
+              << double(renderer.getBytesEmitted()) / frames << " bytes/frame), "
+              << ms * 1000.0 / frames << " us/frame" << std::endl;
+    std::cout << "  clear + redraw: " << legacyBytes << " bytes (" << double(legacyBytes) / frames
+              << " bytes/frame) plus one shell spawn per frame" << std::endl;
+}
+
+// The options that change what a run does, right after the journal's magic and version.
+void writeJournalOptions(EventJournal& journal, const GameOptions& options) {
+    journal.putVarint(uint64_t(options.mapWidth));
+    journal.putVarint(uint64_t(options.mapHeight));
+    journal.putVarint(uint64_t(options.enemyCount));
+    journal.putVarint(uint64_t(options.huntRadius));
+    journal.putVarint(uint64_t(options.sightRadius));
+    journal.putVarint(options.maxMoves);
+    journal.putVarint(uint64_t(options.tickMs));
+    journal.putVarint(options.roam ? 1 : 0);
+    journal.putVarint(options.bossSearch);
+    journal.putVarint(uint64_t(options.interestRadius));
+    journal.putVarint(options.worldDir.empty() ? 0 : 1);
+    journal.putVarint(options.loadPath.size());
+    for (char c : options.loadPath) journal.putVarint(uint8_t(c));
+}
+
+// False if the journal was recorded in a streamed world, whose chunk arrival times are not
+// reproducible.
+bool readJournalOptions(JournalReader& reader, GameOptions& options) {
+    options.mapWidth = int(reader.varint());
+    options.mapHeight = int(reader.varint());
+    options.enemyCount = int(reader.varint());
+    options.huntRadius = int(reader.varint());
+    options.sightRadius = int(reader.varint());
+    options.maxMoves = reader.varint();
+    options.tickMs = int(reader.varint());
+    options.roam = reader.varint() != 0;
+    options.bossSearch = reader.varint();
+    options.interestRadius = int(reader.varint());
+    bool streamed = reader.varint() != 0;
+    options.loadPath.resize(size_t(reader.varint()));
+    for (char& c : options.loadPath) c = char(reader.varint());
+    return !streamed;
+}
+
+// Feeds the inputs of a journal back in order. A read of the wrong kind gets "no input", so a
+// replay that goes off track shows up as a mismatch rather than a hang. The input ends after
+// the read the journal marked as the last one, as RecordingInput wrote it.
+class ReplayInput : public InputSource {
+private:
+    std::vector<JournalReader::Event> inputs;
+    size_t pos = 0;
+    bool ended = false;
+
+    const JournalReader::Event* take(EventJournal::Record type) {
+        if (pos < inputs.size() && inputs[pos].type == type) return &inputs[pos++];
+        return nullptr;
+    }
+
+    void noteEnd() {
+        if (take(EventJournal::EXHAUSTED)) ended = true;
+    }
+
+public:
+    void add(const JournalReader::Event& event) { inputs.push_back(event); }
+
+    char readKey() override {
+        const JournalReader::Event* event = take(EventJournal::KEY);
+        char key = event ? char(event->values[0]) : END_OF_INPUT;
+        noteEnd();
+        return key;
+    }
+
+    char readKeyOrTick(std::chrono::steady_clock::time_point) override {
+        if (!take(EventJournal::TICK)) return readKey();
+        noteEnd();
+        return TICK;
+    }
+
+    int readInt(int lo, int) override {
+        const JournalReader::Event* event = take(EventJournal::NUMBER);
+        int value = event ? int(event->values[0]) : lo - 1;
+        noteEnd();
+        return value;
+    }
+
+    void waitForEnter() override {
+        take(EventJournal::ENTER);
+        noteEnd();
+    }
+
+    bool exhausted() const override { return ended; }
+};
+
+// Re-runs the games in a journal from their seeds and recorded inputs, journaling the replay
+// in memory, and checks that it matches the original record for record.
+int runReplay(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> original((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    JournalReader reader(original);
+    GameOptions options;
+    if (!reader.header()) {
+        std::cerr << path << " is not an Ankr journal." << std::endl;
+        return 1;
+    }
+    if (!readJournalOptions(reader, options)) {
+        std::cerr << path << " was recorded in a streamed world and cannot be replayed exactly." << std::endl;
+        return 1;
+    }
+
+    std::vector<uint64_t> seeds;
+    ReplayInput input;
+    JournalReader::Event event;
+    uint64_t events = 0, finalHash = 0;
+    while (reader.next(event)) {
+        ++events;
+        switch (event.type) {
+            case EventJournal::GAME_START: seeds.push_back(uint64_t(event.values[0])); break;
+            case EventJournal::GAME_END: finalHash = uint64_t(event.values[0]); break;
+            case EventJournal::KEY: case EventJournal::NUMBER: case EventJournal::ENTER: case EventJournal::EXHAUSTED:
+            case EventJournal::TICK:
+                input.add(event);
+                break;
+            default: break;
+        }
+    }
+
+    EventJournal replayed;
+    writeJournalOptions(replayed, options);
+    RecordingInput recorder(input, replayed);
+    options.headless = true;
+    EventJournal::current() = &replayed;
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t seed : seeds) {
+        options.seed = seed;
+        GameManager game(options, &recorder);
+        game.runGame();
+        if (game.getInput().exhausted() || game.quitRequested()) break;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    MessageLog::setVerbosity(MessageLog::DETAIL);
+    EventJournal::current() = nullptr;
+
+    const std::vector<uint8_t>& copy = replayed.bytes();
+    std::cout << "Replayed " << seeds.size() << " games, " << events << " records (" << original.size() << " bytes) in "
+              << ms << " ms" << std::endl;
+    if (copy == original) {
+        std::cout << "Replay matches; final state hash " << std::hex << finalHash << std::dec << std::endl;
+        return 0;
+    }
+
+    JournalReader expected(original), actual(copy);
+    expected.header();
+    actual.header();
+    GameOptions ignored;
+    readJournalOptions(expected, ignored);
+    readJournalOptions(actual, ignored);
+    JournalReader::Event want, got;
+    for (uint64_t index = 0;; ++index) {
+        bool hasWant = expected.next(want), hasGot = actual.next(got);
+        if (!hasWant && !hasGot) break;
+        if (hasWant != hasGot || want.type != got.type || !std::equal(want.values, want.values + 3, got.values)) {
+            std::cout << "Replay diverges at record " << index << " (byte " << (hasWant ? want.offset : original.size())
+                      << "): expected type " << (hasWant ? int(want.type) : 0) << " {" << want.values[0] << ", "
+                      << want.values[1] << ", " << want.values[2] << "}, got type " << (hasGot ? int(got.type) : 0)
+                      << " {" << got.values[0] << ", " << got.values[1] << ", " << got.values[2] << "}" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Replay differs from the journal." << std::endl;
+    return 1;
+}
+
+#ifdef __linux__
+// One player's game, run as a fiber on the worker thread the session was given. When the
+// game wants input that hasn't arrived yet, the fiber switches back to the worker. The
+// fiber's stack, the session and its GameManager share one mapping, with the session's own
+// buffers carved from an arena in it, so a finished session goes away with one munmap.
+class GameSession : public InputSource, public TextSink {
+public:
+    static constexpr size_t GUARD_BYTES = 4096;
+    static constexpr size_t STACK_BYTES = 128 * 1024;
+    static constexpr size_t ARENA_BYTES = 64 * 1024;
+    static constexpr size_t MAPPING_BYTES = GUARD_BYTES + STACK_BYTES + ARENA_BYTES;
+    // A player who sends more than this without the game reading it is dropped.
+    static constexpr size_t MAX_INBOX = 64 * 1024;
+
+private:
+    void* mapping;
+    int fd;
+    unsigned worker;
+    GameOptions options;
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::unsynchronized_pool_resource pool;
+    std::pmr::string inbox;
+    std::pmr::string outbox;
+    size_t readPos = 0;
+    size_t sent = 0;
+    ucontext_t fiber;
+    ucontext_t* caller = nullptr;
+    bool started = false;
+    bool finished = false;
+    bool peerClosed = false;
+    bool registered = false;
+
+    GameSession(void* block, int socket, unsigned workerIndex, const GameOptions& gameOptions)
+        : mapping(block), fd(socket), worker(workerIndex), options(gameOptions),
+          arena(reinterpret_cast<char*>(this + 1), ARENA_BYTES - sizeof(GameSession)),
+          pool(&arena), inbox(&pool), outbox(&pool) {}
+
+    static GameSession*& starting() {
+        thread_local GameSession* session = nullptr;
+        return session;
+    }
+
+    static void fiberMain() {
+        GameSession* session = starting();
+        session->play();
+        session->finished = true;
+    }
+
+    void play() {
+        void* slot = arena.allocate(sizeof(GameManager), alignof(GameManager));
+        GameManager* game = new (slot) GameManager(options, this, this);
+        game->runGame();
+        game->~GameManager();
+    }
+
+    // False once the player has gone and everything they sent has been read.
+    bool awaitInput() {
+        while (readPos == inbox.size()) {
+            if (peerClosed) return false;
+            swapcontext(&fiber, caller);
+        }
+        return true;
+    }
+
+    char take() {
+        char c = inbox[readPos++];
+        if (readPos == inbox.size()) {
+            inbox.clear();
+            readPos = 0;
+        }
+        return c;
+    }
+
+    bool readLine(std::string& line) {
+        line.clear();
+        while (awaitInput()) {
+            char c = take();
+            if (c == '\n') return true;
+            if (c != '\r') line += c;
+        }
+        return false;
+    }
+
+public:
+    static GameSession* create(int socket, unsigned workerIndex, const GameOptions& options) {
+        static_assert(sizeof(GameSession) < ARENA_BYTES / 4, "session header crowds out its arena");
+        void* block = mmap(nullptr, MAPPING_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (block == MAP_FAILED) return nullptr;
+        // The stack grows down into the guard page rather than into another session.
+        mprotect(block, GUARD_BYTES, PROT_NONE);
+        return new (static_cast<char*>(block) + GUARD_BYTES + STACK_BYTES) GameSession(block, socket, workerIndex, options);
+    }
+
+    static void destroy(GameSession* session) {
+        void* block = session->mapping;
+        close(session->fd);
+        session->~GameSession();
+        munmap(block, MAPPING_BYTES);
+    }
+
+    int getFd() const { return fd; }
+    unsigned getWorker() const { return worker; }
+    bool isFinished() const { return finished; }
+    bool isRegistered() const { return registered; }
+    void markRegistered() { registered = true; }
+
+    // Takes everything the socket has for us without blocking.
+    void receive() {
+        char buf[4096];
+        for (;;) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                inbox.append(buf, size_t(n));
+                if (inbox.size() > MAX_INBOX) peerClosed = true;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) peerClosed = true;
+            return;
+        }
+    }
+
+    // Runs the game until it needs input it doesn't have, or ends. On the worker's thread only.
+    void resume(ucontext_t& workerContext) {
+        if (finished) return;
+        caller = &workerContext;
+        if (!started) {
+            started = true;
+            getcontext(&fiber);
+            fiber.uc_stack.ss_sp = static_cast<char*>(mapping) + GUARD_BYTES;
+            fiber.uc_stack.ss_size = STACK_BYTES;
+            fiber.uc_link = &workerContext;
+            makecontext(&fiber, fiberMain, 0);
+            starting() = this;
+        }
+        TextSink*& capture = MessageLog::capture();
+        TextSink* previous = capture;
+        capture = this;
+        swapcontext(&workerContext, &fiber);
+        capture = previous;
+    }
+
+    // Sends what the game wrote; false if the socket is full and some is still waiting.
+    bool flush() {
+        while (sent < outbox.size() && !peerClosed) {
+            ssize_t n = send(fd, outbox.data() + sent, outbox.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += size_t(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return false;
+            } else {
+                peerClosed = true;
+            }
+        }
+        outbox.clear();
+        sent = 0;
+        return true;
+    }
+
+    void write(const char* data, size_t size) override { outbox.append(data, size); }
+
+    char readKey() override {
+        while (awaitInput()) {
+            char c = take();
+            if (!std::isspace(static_cast<unsigned char>(c))) return c;
+        }
+        return END_OF_INPUT;
+    }
+
+    int readInt(int lo, int) override {
+        std::string line;
+        if (!readLine(line)) return lo - 1;
+        try {
+            return std::stoi(line);
+        } catch (const std::exception&) {
+            return lo - 1;
+        }
+    }
+
+    void waitForEnter() override {
+        std::string line;
+        readLine(line);
+    }
+
+    bool exhausted() const override { return peerClosed && readPos == inbox.size(); }
+};
+
+// Hosts independent games behind one listening socket. The calling thread runs an epoll
+// loop that accepts players and hands every readable or writable session to the worker it
+// was pinned to; workers run the game fibers and do the session's reads and writes.
+// Sessions are armed one-shot, so each is in at most one worker's queue at a time.
+class GameServer {
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<GameSession*> queue;
+        ucontext_t context;
+    };
+
+    GameOptions options;
+    int listener = -1;
+    int epollFd = -1;
+    std::vector<std::unique_ptr<Worker>> workers;
+    unsigned nextWorker = 0;
+    uint64_t accepted = 0;
+    std::atomic<uint64_t> live{ 0 };
+    std::atomic<uint64_t> completed{ 0 };
+
+    void schedule(GameSession* session) {
+        Worker& worker = *workers[session->getWorker()];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.queue.push_back(session);
+        }
+        worker.ready.notify_one();
+    }
+
+    void work(Worker& worker) {
+        for (;;) {
+            GameSession* session;
+            {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.ready.wait(lock, [&] { return !worker.queue.empty(); });
+                session = worker.queue.front();
+                worker.queue.pop_front();
+            }
+            session->receive();
+            session->resume(worker.context);
+            bool drained = session->flush();
+            if (session->isFinished() && (drained || session->exhausted())) {
+                GameSession::destroy(session);
+                live.fetch_sub(1, std::memory_order_relaxed);
+                completed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            epoll_event event = {};
+            event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT | (drained ? 0 : uint32_t(EPOLLOUT));
+            event.data.ptr = session;
+            epoll_ctl(epollFd, session->isRegistered() ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, session->getFd(), &event);
+            session->markRegistered();
+        }
+    }
+
+    void acceptAll() {
+        for (;;) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            GameOptions sessionOptions = options;
+            if (options.seed) sessionOptions.seed = options.seed + accepted;
+            GameSession* session = GameSession::create(fd, nextWorker, sessionOptions);
+            if (!session) {
+                close(fd);
+                continue;
+            }
+            nextWorker = (nextWorker + 1) % unsigned(workers.size());
+            ++accepted;
+            live.fetch_add(1, std::memory_order_relaxed);
+            // Sent straight to its worker so the player sees the welcome before typing anything.
+            schedule(session);
+        }
+    }
+
+public:
+    explicit GameServer(const GameOptions& gameOptions) : options(gameOptions) {
+        // Each session is its own game with no terminal, save files or shared world.
+        options.headless = false;
+        options.loadPath.clear();
+        options.savePath.clear();
+        options.autosaveMoves = 0;
+        options.worldDir.clear();
+        options.tickMs = 0;
+    }
+
+    // `address` is a TCP port on localhost, HOST:PORT, or a Unix socket path.
+    bool listenOn(const std::string& address) {
+        bool unixSocket = address.find('/') != std::string::npos ||
+                          address.find_first_not_of("0123456789.:") != std::string::npos;
+        if (unixSocket) {
+            sockaddr_un local = {};
+            local.sun_family = AF_UNIX;
+            if (address.size() >= sizeof(local.sun_path)) return false;
+            std::copy(address.begin(), address.end(), local.sun_path);
+            unlink(address.c_str());
+            listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) return false;
+        } else {
+            size_t colon = address.rfind(':');
+            std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+            sockaddr_in inet = {};
+            inet.sin_family = AF_INET;
+            inet.sin_port = htons(uint16_t(std::stoi(colon == std::string::npos ? address : address.substr(colon + 1))));
+            if (inet_pton(AF_INET, host.c_str(), &inet.sin_addr) != 1) return false;
+            listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int one = 1;
+            if (listener >= 0) setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&inet), sizeof(inet)) < 0) return false;
+        }
+        return ::listen(listener, SOMAXCONN) == 0;
+    }
+
+    int run(unsigned workerCount) {
+        // Every player is a descriptor; take as many as the hard limit allows.
+        rlimit files;
+        if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+            files.rlim_cur = files.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &files);
+        }
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event listen = {};
+        listen.events = EPOLLIN;
+        listen.data.ptr = nullptr;
+        if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listener, &listen) < 0) return 1;
+        for (unsigned i = 0; i < std::max(workerCount, 1u); ++i) {
+            workers.push_back(std::make_unique<Worker>());
+            Worker& worker = *workers.back();
+            worker.thread = std::thread([this, &worker] { work(worker); });
+        }
+
+        std::vector<epoll_event> events(1024);
+        auto lastReport = std::chrono::steady_clock::now();
+        uint64_t reportedLive = 0, reportedCompleted = 0;
+        for (;;) {
+            int count = epoll_wait(epollFd, events.data(), int(events.size()), 1000);
+            for (int i = 0; i < count; ++i) {
+                if (events[i].data.ptr) {
+                    schedule(static_cast<GameSession*>(events[i].data.ptr));
+                } else {
+                    acceptAll();
+                }
+            }
+            auto now = std::chrono::steady_clock::now();
+            uint64_t nowLive = live.load(std::memory_order_relaxed), nowCompleted = completed.load(std::memory_order_relaxed);
+            if (now - lastReport >= std::chrono::seconds(10) && (nowLive != reportedLive || nowCompleted != reportedCompleted)) {
+                std::cerr << nowLive << " sessions open, " << nowCompleted << " games finished" << std::endl;
+                lastReport = now;
+                reportedLive = nowLive;
+                reportedCompleted = nowCompleted;
+            }
+        }
+    }
+};
+
+int runServer(const std::string& address, const GameOptions& options, unsigned workers) {
+    GameServer server(options);
+    if (!server.listenOn(address)) {
+        perror(("Cannot listen on " + address).c_str());
+        return 1;
+    }
+    std::cerr << "Serving Ankr on " << address << " with " << workers << " workers" << std::endl;
+    return server.run(workers);
+}
+#else
+int runServer(const std::string&, const GameOptions&, unsigned) {
+    std::cerr << "--serve needs epoll and is only available on Linux." << std::endl;
+    return 1;
+}
+#endif
+
+void runSpawnBenchmark(int size) {
+    std::cout << "Spawn benchmark: " << size << " x " << size << " map" << std::endl;
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    for (double density : { 0.1, 0.5, 0.9, 1.0 }) {
+        GameOptions options;
+        options.mapWidth = size;
+        options.mapHeight = size;
+        options.headless = true;
+        options.seed = 1;
+        GameManager game(options);
+        game.setPlayerPosition(2, 2);
+        int count = int(double(game.getMap().countOf(TileType::EMPTY)) * density);
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = game.spawnEnemies(count);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        MessageLog::setVerbosity(MessageLog::DETAIL);
+        std::cout << "  " << int(density * 100) << "% full: " << count << " enemies in " << ms << " ms"
+                  << (ok ? "" : " (refused)") << std::endl;
+        MessageLog::setVerbosity(MessageLog::SILENT);
+    }
+    MessageLog::setVerbosity(MessageLog::DETAIL);
+}
+
+// Wandering enemies only, so the whole tick is the region-parallel part. Every thread count
+// must end in the same state.
+void runTickBenchmark(int size) {
+    const int ticks = 50;
+    unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    std::cout << "Tick benchmark: " << size << " x " << size << " map, 10% enemies, " << ticks << " ticks per run, "
+              << cores << " cores" << std::endl;
+    uint64_t firstHash = 0;
+    double firstRate = 0;
+    bool same = true;
+    for (unsigned threads = 1; threads <= std::max(cores, 4u); threads *= 2) {
+        GameOptions options;
+        options.mapWidth = size;
+        options.mapHeight = size;
+        options.headless = true;
+        options.seed = 1;
+        options.huntRadius = 0;
+        options.roam = true;
+        options.interestRadius = 0;
+        options.tickThreads = int(threads);
+        MessageLog::setVerbosity(MessageLog::SILENT);
+        GameManager game(options);
+        game.spawnEnemies(int(double(game.getMap().countOf(TileType::EMPTY)) * 0.1));
+        MessageLog::setVerbosity(MessageLog::DETAIL);
+        game.tickEnemies(false);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int tick = 0; tick < ticks; ++tick) game.tickEnemies(false);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        double rate = ticks / seconds;
+        uint64_t hash = game.stateHash();
+        if (threads == 1) {
+            firstHash = hash;
+            firstRate = rate;
+        }
+        same = same && hash == firstHash;
+        std::cout << "  " << threads << " threads: " << rate << " ticks/s, " << rate / firstRate << "x"
+                  << (threads > cores ? " (more threads than cores)" : "") << ", state " << std::hex << hash << std::dec
+                  << std::endl;
+    }
+    std::cout << (same ? "Every thread count reached the same state." : "MISMATCH: the state depends on the thread count.")
+              << std::endl;
+
+    // With the default interest radius only the regions around the hero move, so the cost of
+    // a tick should not grow with the map.
+    std::cout << "With an interest radius of " << GameOptions().interestRadius << ", 1 thread:" << std::endl;
+    for (int side = std::max(size / 4, 16); side <= size; side *= 2) {
+        GameOptions options;
+        options.mapWidth = side;
+        options.mapHeight = side;
+        options.headless = true;
+        options.seed = 1;
+        options.huntRadius = 0;
+        options.roam = true;
+        MessageLog::setVerbosity(MessageLog::SILENT);
+        GameManager game(options);
+        game.spawnEnemies(int(double(game.getMap().countOf(TileType::EMPTY)) * 0.1));
+        MessageLog::setVerbosity(MessageLog::DETAIL);
+        game.tickEnemies(false);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int tick = 0; tick < ticks; ++tick) game.tickEnemies(false);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "  " << side << " x " << side << ": " << ticks / seconds << " ticks/s, "
+                  << game.getEnemies().size() << " enemies" << std::endl;
+    }
+}
+
+void runAiBenchmark(int size) {
+    std::cout << "AI benchmark: " << size << " x " << size << " map, 200 ticks per run" << std::endl;
+    for (int radius : { 32, 64, 128 }) {
+        for (double density : { 0.05, 0.3 }) {
+            GameOptions options;
+            options.mapWidth = size;
+            options.mapHeight = size;
+            options.headless = true;
+            options.seed = 1;
+            options.huntRadius = radius;
+            MessageLog::setVerbosity(MessageLog::SILENT);
+            GameManager game(options);
+            Map& map = game.getMap();
+            for (int x = 8; x < size - 8; x += 16) map.fillRect(x, 4, x + 1, size - 4, TileType::WALL);
+            int heroX = size / 2 + 3, heroY = size / 2;
+            game.setPlayerPosition(heroX, heroY);
+            int window = 2 * radius + 1;
+            game.spawnEnemies(int(double(map.countOf(TileType::EMPTY)) * density));
+            MessageLog::setVerbosity(MessageLog::DETAIL);
+
+            size_t hunters = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (int tick = 0; tick < 200; ++tick) {
+                // Alternate hero steps with a wall opening or closing next to the hero.
+                if (tick % 2 == 0) {
+                    int nextY = heroY + ((tick / 2) % 20 < 10 ? 1 : -1);
+                    if (map.getTile(heroX, nextY) == TileType::EMPTY) {
+                        game.setPlayerPosition(heroX, nextY);
+                        heroY = nextY;
+                    }
+                } else {
+                    int wallX = heroX + 2, wallY = heroY;
+                    TileType tile = map.getTile(wallX, wallY);
+                    if (tile == TileType::WALL) map.setTile(wallX, wallY, TileType::EMPTY);
+                    else if (tile == TileType::EMPTY) map.setTile(wallX, wallY, TileType::WALL);
+                }
+                game.tickEnemies(false);
+            }
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+            int left = heroX - radius, top = heroY - radius;
+            for (int y = top; y < top + window; ++y) {
+                for (int x = left; x < left + window; ++x) hunters += map.getTile(x, y) == TileType::ENEMY;
+            }
+            std::cout << "  radius " << radius << ", " << int(density * 100) << "% enemies: ~" << hunters
+                      << " hunters, " << us / 200 << " us/tick (" << game.getFlowField().getRebuilds() << " rebuilds, "
+                      << game.getFlowField().getRepairs() << " repairs)" << std::endl;
+        }
+    }
+
+    // What one A* search per hunter would cost instead of the shared field.
+    Map map(size, size);
+    for (int x = 8; x < size - 8; x += 16) map.fillRect(x, 4, x + 1, size - 4, TileType::WALL);
+    PathFinder finder;
+    std::vector<std::pair<int, int>> path;
+    Rng rng(1);
+    int queries = 1000, found = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        int x = size / 2 + rng.range(-64, 64), y = size / 2 + rng.range(-64, 64);
+        found += finder.findPath(map, x, y, size / 2 + 3, size / 2, path, 1u << 20);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "  A* per hunter: " << us / queries << " us/query (" << found << "/" << queries << " found)" << std::endl;
+}
+
+void runFovBenchmark(int size) {
+    Map map(size, size);
+    Rng rng(1);
+    for (size_t i = 0; i < size_t(size) * size / 20; ++i) {
+        map.setTile(rng.range(1, size - 2), rng.range(1, size - 2), rng.below(4) ? TileType::WALL : TileType::ENEMY);
+    }
+    std::cout << "FOV benchmark: " << size << " x " << size << " map, 5% walls and enemies" << std::endl;
+    for (int radius : { 8, 32, 128 }) {
+        FieldOfView sight(radius);
+        int computes = 2000;
+        size_t visibleTiles = 0, visibleEnemies = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < computes; ++i) {
+            sight.update(map, size / 2 + i % 64, size / 2);
+            visibleTiles += sight.countVisible();
+            sight.forEachVisible(map, TileType::ENEMY, [&](int, int) { ++visibleEnemies; });
+        }
+        double computeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+        int queries = 1000000;
+        size_t hits = 0;
+        begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < queries; ++i) {
+            sight.update(map, size / 2 + 63, size / 2);
+            hits += sight.isVisible(size / 2 + 63 + int(rng.range(-radius, radius)), size / 2 + int(rng.range(-radius, radius)));
+        }
+        double queryNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "  radius " << radius << ": " << computeUs / computes << " us per recompute ("
+                  << visibleTiles / computes << " tiles, " << visibleEnemies / computes << " enemies in sight), "
+                  << queryNs / queries << " ns per cached query (" << hits << " visible)" << std::endl;
+    }
+}
+
+void runSaveBenchmark(int size) {
+    std::string path = "ankr-bench.sav";
+    GameOptions options;
+    options.mapWidth = size;
+    options.mapHeight = size;
+    options.headless = true;
+    options.seed = 1;
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    GameManager game(options);
+    game.setPlayer(makeHero(1));
+    game.setPlayerPosition(2, 2);
+    game.spawnEnemies(int(game.getMap().countOf(TileType::EMPTY) / 8));
+    MessageLog::setVerbosity(MessageLog::DETAIL);
+    std::cout << "Save benchmark: " << size << " x " << size << " tiles, " << game.getEnemies().size() << " enemies" << std::endl;
+
+    auto time = [](auto&& fn) {
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        return std::make_pair(ok, ms);
+    };
+    auto full = time([&] { return game.saveSnapshot(path); });
+    std::cout << "  full save:        " << full.second << " ms, " << game.getLastSaveChunks() << " chunks"
+              << (full.first ? "" : " (failed)") << std::endl;
+    Rng rng(2);
+    for (int changed = 0; changed < 100;) {
+        int x = rng.range(1, size - 2), y = rng.range(1, size - 2);
+        if (game.getMap().getTile(x, y) != TileType::EMPTY) continue;
+        game.getMap().setTile(x, y, TileType::WALL);
+        ++changed;
+    }
+    auto incremental = time([&] { return game.saveSnapshot(path); });
+    std::cout << "  incremental save: " << incremental.second << " ms, " << game.getLastSaveChunks()
+              << " chunks after 100 tile changes" << (incremental.first ? "" : " (failed)") << std::endl;
+
+    options.loadPath = path;
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    GameManager resumed(options);
+    MessageLog::setVerbosity(MessageLog::DETAIL);
+    auto load = time([&] { return resumed.loadSnapshot(path); });
+    const Map& a = game.getMap();
+    const Map& b = resumed.getMap();
+    bool same = a.wordCount() == b.wordCount() && std::equal(a.words(), a.words() + a.wordCount(), b.words()) &&
+                game.getEnemies().size() == resumed.getEnemies().size();
+    std::cout << "  load:             " << load.second << " ms" << (load.first ? "" : " (failed)")
+              << (same ? ", state matches" : ", STATE DIFFERS") << std::endl;
+
+    // A cleared map writes no enemy records at all, which the loader must still accept.
+    EnemyStore& enemies = game.getEnemies();
+    while (enemies.size() > 0) game.removeEnemy(enemies.xOf(enemies.idAt(0)), enemies.yOf(enemies.idAt(0)));
+    bool emptySaved = game.saveSnapshot(path);
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    GameManager emptied(options);
+    MessageLog::setVerbosity(MessageLog::DETAIL);
+    bool emptyLoaded = emptySaved && emptied.loadSnapshot(path);
+    std::cout << "  no enemies:       " << (emptyLoaded && emptied.stateHash() == game.stateHash() ? "round trip matches" : "ROUND TRIP FAILED")
+              << std::endl;
+    std::remove(path.c_str());
+}
+
+void runWorldBenchmark(int steps) {
+    std::string dir = "ankr-bench-world";
+    GameOptions options;
+    options.headless = true;
+    options.seed = 1;
+    options.worldDir = dir;
+    options.worldCache = 64;
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    {
+        std::stringstream script;
+        script << "1\n\nq";
+        ScriptedInput input(script.str(), false);
+        GameManager game(options, &input);
+        game.runGame();
+        MessageLog::setVerbosity(MessageLog::DETAIL);
+        std::cout << "World benchmark: " << steps << " steps east, one tick each" << std::endl;
+
+        ChunkedWorld& world = *game.getWorld();
+        double totalUs = 0, worstUs = 0;
+        size_t peakResident = 0, unready = 0;
+        for (int i = 0; i < steps; ++i) {
+            // Walk straight through walls and enemies: the benchmark is about streaming, not paths.
+            int x = game.getPlayerX() + 1, y = game.getPlayerY();
+            if (game.getMap().getTile(x, y) == TileType::ENEMY) game.removeEnemy(x, y);
+            game.setPlayerPosition(x, y);
+            auto begin = std::chrono::steady_clock::now();
+            game.tickEnemies(false);
+            game.streamWorld();
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+            totalUs += us;
+            worstUs = std::max(worstUs, us);
+            peakResident = std::max(peakResident, world.residentCount());
+            int cx = (game.heroWorldX() >= 0 ? game.heroWorldX() : game.heroWorldX() - 31) / ChunkedWorld::CHUNK_SIZE;
+            int cy = (game.heroWorldY() >= 0 ? game.heroWorldY() : game.heroWorldY() - 31) / ChunkedWorld::CHUNK_SIZE;
+            if (!world.find(cx + 1, cy)) ++unready;
+            // Roughly the pace of someone holding a key down.
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        world.flush();
+        std::cout << "  " << totalUs / steps << " us/step average, " << worstUs << " us worst" << std::endl;
+        std::cout << "  " << world.getGenerated() << " chunks generated, " << world.getStored() << " written to disk, "
+                  << peakResident << " resident at most, next chunk not ready on " << unready << " steps" << std::endl;
+    }
+    std::filesystem::remove_all(dir);
+}
+
+// Plays scripted fights with drawing and game text switched on, counting heap allocations
+// in every combat turn after the first game and in whole startCombat calls. Returns false if
+// any of them allocated, or if the build does not count allocations.
+bool runAllocationCheck(uint64_t turns) {
+#ifndef ANKR_COUNT_ALLOCS
+    (void)turns;
+    std::cout << "Allocation check: this build does not count heap allocations; configure with -DANKR_COUNT_ALLOCS=ON"
+              << std::endl;
+    return false;
+#else
+    struct DiscardSink : TextSink {
+        size_t bytes = 0;
+        void write(const char*, size_t size) override { bytes += size; }
+    } sink;
+    struct TurnCounter : CombatObserver {
+        uint64_t mark = 0;
+        bool inFight = false;
+        bool measuring = false;
+        uint64_t turns = 0;
+        uint64_t allocations = 0;
+        uint64_t worst = 0;
+        void onRound(int round, const Character&, const Character&) override {
+            uint64_t now = heapAllocations();
+            if (measuring && round > 0) {
+                ++turns;
+                allocations += now - mark;
+                worst = std::max(worst, now - mark);
+            }
+            mark = now;
+        }
+    } counter;
+
+    GameOptions options;
+    options.mapWidth = 60;
+    options.mapHeight = 30;
+    options.enemyCount = 300;
+    options.seed = 7;
+    options.maxMoves = 4000;
+    // Attack, use the sword, shield, heal, then walk on; mostly it's the enemies that come.
+    std::string script = "3\n\n d 1 2 1 1 2 2 3 1 s 1 1 2 1 a 1 3 1 w 1 2 1 1 ";
+    TextSink*& capture = MessageLog::capture();
+    TextSink* previous = capture;
+    capture = &sink;
+    uint64_t games = 0, gameAllocations = 0, gameMoves = 0;
+    while (counter.turns < turns && games < 1000) {
+        ScriptedInput input(script, true);
+        options.seed = 7 + games;
+        counter.measuring = games > 0;
+        uint64_t before = heapAllocations();
+        {
+            GameManager game(options, &input, &sink);
+            game.setCombatObserver(&counter);
+            game.runGame();
+            if (games > 0) gameMoves += game.getMovesProcessed();
+        }
+        if (games > 0) gameAllocations += heapAllocations() - before;
+        ++games;
+    }
+
+    // Whole fights, from startCombat to its return, against every enemy kind in turn. As above
+    // the first game is left out, and so is each game's first fight while its tables grow.
+    // The counts cover every form of operator new; the probe below makes sure of that, since
+    // an uncounted nothrow or aligned allocation would pass for none at all.
+    struct alignas(64) Wide { char bytes[64]; };
+    uint64_t probe = heapAllocations();
+    int* volatile plain = new (std::nothrow) int(0);
+    int* volatile array = new int[2];
+    Wide* volatile wide = new Wide;
+    Wide* volatile wideArray = new (std::nothrow) Wide[2];
+    bool countsEveryForm = heapAllocations() - probe == 4;
+    delete plain;
+    delete[] array;
+    delete wide;
+    delete[] wideArray;
+    uint64_t fights = 0, fightAllocations = 0, worstFight = 0;
+    for (uint64_t game = 0; fights < std::max<uint64_t>(turns / 8, 1) && game < 1000; ++game) {
+        GameOptions duel;
+        duel.mapWidth = 5;
+        duel.mapHeight = 5;
+        duel.seed = 11 + game;
+        ScriptedInput input("1 2 1 3 1 2 2 1 1 2 1 2 2 1 3 1 ", true);
+        GameManager arena(duel, &input, &sink);
+        arena.setPlayer(makeHero(3, arena.getArena().resource()));
+        arena.setPlayerPosition(2, 2);
+        for (int fight = 0; arena.isRunning() && fight < 64; ++fight) {
+            Character& hero = arena.getPlayer();
+            hero.restoreHealth(hero.getMaxHealth(), hero.getMaxHealth());
+            arena.placeEnemy(3, 2, static_cast<EnemyKind>(fight % ENEMY_KIND_COUNT));
+            uint64_t before = heapAllocations();
+            arena.startCombat(3, 2);
+            uint64_t used = heapAllocations() - before;
+            arena.removeEnemy(3, 2);
+            if (game == 0 || fight == 0) continue;
+            ++fights;
+            fightAllocations += used;
+            worstFight = std::max(worstFight, used);
+        }
+    }
+    capture = previous;
+
+    std::cout << "Allocation check: " << counter.turns << " combat turns over " << games - 1 << " games ("
+              << sink.bytes << " bytes of output discarded)" << std::endl;
+    std::cout << "  per combat turn: " << double(counter.allocations) / double(std::max<uint64_t>(counter.turns, 1))
+              << " allocations on average, " << counter.worst << " at most" << std::endl;
+    std::cout << "  per game:        " << double(gameAllocations) / double(std::max<uint64_t>(games - 1, 1))
+              << " allocations, setup and teardown included, over " << gameMoves / std::max<uint64_t>(games - 1, 1)
+              << " moves" << std::endl;
+    std::cout << "  per whole fight: " << double(fightAllocations) / double(std::max<uint64_t>(fights, 1))
+              << " allocations on average, " << worstFight << " at most, over " << fights << " fights" << std::endl;
+    if (!countsEveryForm) std::cout << "  the nothrow, array or aligned operator new is not being counted" << std::endl;
+    bool clean = countsEveryForm && counter.turns > 0 && counter.allocations == 0 && fights > 0 && fightAllocations == 0;
+    std::cout << (clean ? "  OK: combat does not touch the heap" : "  FAIL: combat allocates") << std::endl;
+    return clean;
+#endif
+}
+
+void runJournalBenchmark(uint64_t moves) {
+    std::string path = "ankr-bench.journal";
+    GameOptions options;
+    options.headless = true;
+    options.seed = 1;
+    options.mapWidth = 200;
+    options.mapHeight = 200;
+    options.enemyCount = 2000;
+    options.maxMoves = moves;
+    options.huntRadius = 0;
+    // Fight one round and run, so the hero survives the whole run.
+    std::string script = "3\n\n d 1 4 d 1 4 s 1 4 s 1 4 a 1 4 a 1 4 w 1 4 w 1 4 ";
+
+    auto play = [&](bool journaled) {
+        ScriptedInput input(script, true);
+        EventJournal journal(journaled ? path : "");
+        RecordingInput recorder(input, journal);
+        if (journaled) EventJournal::current() = &journal;
+        MessageLog::setVerbosity(MessageLog::SILENT);
+        auto begin = std::chrono::steady_clock::now();
+        GameManager game(options, journaled ? static_cast<InputSource*>(&recorder) : &input);
+        game.runGame();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        MessageLog::setVerbosity(MessageLog::DETAIL);
+        EventJournal::current() = nullptr;
+        return std::make_pair(ms, journal.recordCount());
+    };
+
+    play(false);
+    auto plain = play(false);
+    auto journaled = play(true);
+    std::ifstream written(path, std::ios::binary | std::ios::ate);
+    double bytes = double(written.tellg());
+    std::cout << "Journal benchmark: " << moves << " moves" << std::endl;
+    std::cout << "  without journal: " << plain.first << " ms" << std::endl;
+    std::cout << "  with journal:    " << journaled.first << " ms, " << journaled.second << " records, "
+              << bytes / double(journaled.second) << " bytes/record, "
+              << (journaled.first - plain.first) * 1e6 / double(journaled.second) << " ns/record extra" << std::endl;
+    std::remove(path.c_str());
+}
+
+// Writes the same combat line `lines` times to a file: flushed one line at a time through an
+// ostream, the way game text used to go out, then through the MessageLog.
+void runLogBenchmark(uint64_t lines) {
+    std::string path = "ankr-bench.log";
+    std::string name = "Skeleton";
+    auto elapsedMs = [](std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    };
+
+    double streamMs;
+    {
+        std::ofstream out(path);
+        auto begin = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < lines; ++i) {
+            out << name << " takes " << 20 << " damage. Health is now " << int(i % 100) << std::endl;
+        }
+        streamMs = elapsedMs(begin);
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) return;
+    MessageLog::setOutput(file);
+    uint64_t batchesBefore = MessageLog::getBatches();
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < lines; ++i) {
+        logMessage<MessageLog::EVENT>("{} takes {} damage. Health is now {}\n", name, 20, int(i % 100));
+    }
+    double postMs = elapsedMs(begin);
+    MessageLog::sync();
+    double logMs = elapsedMs(begin);
+    uint64_t batches = MessageLog::getBatches() - batchesBefore;
+    MessageLog::setOutput(nullptr);
+    std::fclose(file);
+
+    MessageLog::setVerbosity(MessageLog::SILENT);
+    begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < lines; ++i) {
+        logMessage<MessageLog::EVENT>("{} takes {} damage. Health is now {}\n", name, 20, int(i % 100));
+    }
+    double silentMs = elapsedMs(begin);
+    MessageLog::setVerbosity(MessageLog::DETAIL);
+    std::remove(path.c_str());
+
+    std::cout << "Log benchmark: " << lines << " lines" << std::endl;
+    std::cout << "  ostream + endl: " << streamMs * 1e6 / double(lines) << " ns/line" << std::endl;
+    std::cout << "  MessageLog:     " << postMs * 1e6 / double(lines) << " ns/line to post, " << logMs * 1e6 / double(lines)
+              << " ns/line until written, " << batches << " writes" << std::endl;
+    std::cout << "  silenced:       " << silentMs * 1e6 / double(lines) << " ns/line" << std::endl;
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "ankr.h"
+
+// Fixed set of worker threads pulling tasks from one queue.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    size_t pending = 0;
+    bool stopping = false;
+
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) allDone.notify_all();
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned threads) {
+        threads = std::max(threads, 1u);
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskReady.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+            ++pending;
+        }
+        taskReady.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+
+    size_t size() const { return workers.size(); }
+};
+
+// Plays one side of a simulated duel: picks a random action other than running away, answers
+// every ability prompt uniformly within the range the prompt asks for, and gives up (runs away)
+// if a fight drags on past MAX_ROUNDS.
+class DuelPolicy : public InputSource, public CombatObserver {
+public:
+    static constexpr int MAX_ROUNDS = 200;
+    static constexpr int CURVE_ROUNDS = 32;
+
+    Rng rng;
+    bool actionNext = false;
+    int rounds = 0;
+    int heroHpAt[CURVE_ROUNDS];
+
+    explicit DuelPolicy(uint64_t seed) : rng(seed) {}
+
+    void onRound(int round, const Character& hero, const Character&) override {
+        actionNext = true;
+        rounds = round + 1;
+        if (round < CURVE_ROUNDS) heroHpAt[round] = hero.getHealth();
+    }
+
+    char readKey() override { return END_OF_INPUT; }
+
+    int readInt(int lo, int hi) override {
+        if (actionNext) {
+            actionNext = false;
+            if (rounds > MAX_ROUNDS) return 4;
+            return rng.range(1, 3);
+        }
+        return rng.range(lo, std::max(lo, hi));
+    }
+
+    void waitForEnter() override {}
+    bool exhausted() const override { return false; }
+};
+
+struct DuelStats {
+    static constexpr int TURN_BUCKETS = 64;
+
+    uint64_t trials = 0;
+    uint64_t heroWins = 0;
+    uint64_t enemyWins = 0;
+    uint64_t gameEnded = 0;
+    uint64_t timeouts = 0;
+    uint64_t winTurns[TURN_BUCKETS] = {};
+    uint64_t totalWinTurns = 0;
+    uint64_t curveSum[DuelPolicy::CURVE_ROUNDS] = {};
+    uint64_t curveCount[DuelPolicy::CURVE_ROUNDS] = {};
+
+    void merge(const DuelStats& other) {
+        trials += other.trials;
+        heroWins += other.heroWins;
+        enemyWins += other.enemyWins;
+        gameEnded += other.gameEnded;
+        timeouts += other.timeouts;
+        totalWinTurns += other.totalWinTurns;
+        for (int i = 0; i < TURN_BUCKETS; ++i) winTurns[i] += other.winTurns[i];
+        for (int i = 0; i < DuelPolicy::CURVE_ROUNDS; ++i) {
+            curveSum[i] += other.curveSum[i];
+            curveCount[i] += other.curveCount[i];
+        }
+    }
+
+    uint64_t winTurnPercentile(double p) const {
+        if (heroWins == 0) return 0;
+        uint64_t target = uint64_t(p * heroWins);
+        uint64_t seen = 0;
+        for (int i = 0; i < TURN_BUCKETS; ++i) {
+            seen += winTurns[i];
+            if (seen > target) return i + 1;
+        }
+        return TURN_BUCKETS;
+    }
+};
+
+// Runs `trials` duels of one hero against one enemy kind through GameManager::startCombat.
+// Each block of trials gets its own seed derived from (seed, pairing, block), so the totals
+// do not depend on how many threads ran them.
+class CombatSimulator {
+public:
+    static constexpr uint64_t BLOCK_SIZE = 1024;
+    static constexpr int HERO_COUNT = 5;
+
+private:
+    RngService seeds;
+    ThreadPool pool;
+    uint64_t bossSearch;
+
+    static void runBlock(int hero, int enemyKind, uint64_t blockSeed, uint64_t count, uint64_t bossSearch, DuelStats& stats) {
+        DuelPolicy policy(blockSeed);
+        GameOptions options;
+        options.mapWidth = 5;
+        options.mapHeight = 5;
+        options.headless = true;
+        options.bossSearch = bossSearch;
+        for (uint64_t t = 0; t < count; ++t) {
+            options.seed = policy.rng.next() | 1;
+            GameManager game(options, &policy);
+            game.setCombatObserver(&policy);
+            game.setPlayer(makeHero(hero, game.getArena().resource()));
+            game.setPlayerPosition(2, 2);
+            game.placeEnemy(3, 2, static_cast<EnemyKind>(enemyKind));
+            game.startCombat(3, 2);
+
+            ++stats.trials;
+            int rounds = policy.rounds;
+            for (int r = 0; r < std::min(rounds, DuelPolicy::CURVE_ROUNDS); ++r) {
+                stats.curveSum[r] += policy.heroHpAt[r];
+                ++stats.curveCount[r];
+            }
+            if (!game.isRunning() && game.getPlayer().isAlive()) {
+                ++stats.gameEnded;
+            } else if (!game.getPlayer().isAlive()) {
+                ++stats.enemyWins;
+            } else if (game.getEnemies().size() == 0) {
+                ++stats.heroWins;
+                stats.totalWinTurns += rounds;
+                ++stats.winTurns[std::min(rounds, DuelStats::TURN_BUCKETS) - 1];
+            } else {
+                ++stats.timeouts;
+            }
+        }
+    }
+
+public:
+    CombatSimulator(uint64_t masterSeed, unsigned threads, uint64_t bossSearchTurns = 0)
+        : seeds(masterSeed), pool(threads), bossSearch(bossSearchTurns) {}
+
+    // Results indexed [hero - 1][enemy kind].
+    std::vector<DuelStats> run(uint64_t trialsPerPairing) {
+        const int pairings = HERO_COUNT * ENEMY_KIND_COUNT;
+        uint64_t blocks = (trialsPerPairing + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        std::vector<DuelStats> blockStats(size_t(pairings) * blocks);
+        for (int p = 0; p < pairings; ++p) {
+            for (uint64_t b = 0; b < blocks; ++b) {
+                uint64_t count = std::min(BLOCK_SIZE, trialsPerPairing - b * BLOCK_SIZE);
+                uint64_t blockSeed = seeds.streamSeed(RngService::THREAD_BASE * RngService::SIMULATION + uint64_t(p) * blocks + b);
+                DuelStats* out = &blockStats[size_t(p) * blocks + b];
+                pool.submit([=] { runBlock(p / ENEMY_KIND_COUNT + 1, p % ENEMY_KIND_COUNT, blockSeed, count, bossSearch, *out); });
+            }
+        }
+        pool.wait();
+        std::vector<DuelStats> results(pairings);
+        for (int p = 0; p < pairings; ++p) {
+            for (uint64_t b = 0; b < blocks; ++b) results[p].merge(blockStats[size_t(p) * blocks + b]);
+        }
+        return results;
+    }
+
+    size_t threadCount() const { return pool.size(); }
+};
+
+// The command-line modes other than playing a game, defined in tools.cpp.
+void runCombatSimulation(uint64_t trialsPerPairing, unsigned threads, uint64_t seed, uint64_t bossSearch = 0);
+void writeJournalOptions(EventJournal& journal, const GameOptions& options);
+bool readJournalOptions(JournalReader& reader, GameOptions& options);
+int runReplay(const std::string& path);
+int runServer(const std::string& address, const GameOptions& options, unsigned workers);
+bool runAllocationCheck(uint64_t turns);
+void runMapBenchmark(int size);
+void runRenderBenchmark(int frames);
+void runSpawnBenchmark(int size);
+void runAiBenchmark(int size);
+void runTickBenchmark(int size);
+void runFovBenchmark(int size);
+void runSaveBenchmark(int size);
+void runWorldBenchmark(int steps);
+void runJournalBenchmark(uint64_t moves);
+void runLogBenchmark(uint64_t lines);